@@ -0,0 +1,40 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t threadAllocations = 0;
+
+uint64_t getThreadAllocationCount(){
+    return threadAllocations;
+}
+
+// the array, nothrow and sized forms of the standard library forward to these
+void* operator new(std::size_t size){
+    threadAllocations++;
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void* operator new[](std::size_t size){
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept{
+    std::free(memory);
+}
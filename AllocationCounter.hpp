@@ -0,0 +1,13 @@
+#ifndef AllocationCounter_hpp
+#define AllocationCounter_hpp
+
+#pragma once
+
+#include <cstdint>
+
+// AllocationCounter.cpp replaces the global operator new and delete. Every allocation through them bumps a
+// counter of the calling thread, so a loop can tell whether it reached the heap. Costs a thread local
+// increment per allocation. Memory the driver or C code gets from malloc is not counted.
+uint64_t getThreadAllocationCount();
+
+#endif /* AllocationCounter_hpp */
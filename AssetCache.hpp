@@ -0,0 +1,129 @@
+#ifndef AssetCache_hpp
+#define AssetCache_hpp
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+// 64-bit FNV-1a, identifies file contents
+static inline uint64_t hashContent(const void *data, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static inline uint64_t hashCombine(uint64_t hash, uint64_t other) {
+    return hash ^ (other + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+// Reference counted assets keyed by content hash. Paths map to the hash of the content last loaded from them,
+// so a repeated path skips reading the file and a copy under another path still finds the same entry.
+// Holds no GPU objects itself: the owner destroys a value once release() reports the last reference gone.
+template<typename T>
+class AssetCache{
+public:
+    // both add a reference, nullptr when nothing is cached
+    T* acquire(uint64_t hash){
+        auto entry = entries.find(hash);
+        if (entry == entries.end()) {
+            return nullptr;
+        }
+        entry->second.refCount++;
+        hits++;
+        return &entry->second.value;
+    }
+    T* acquirePath(const std::string &path, uint64_t &hash){
+        auto known = paths.find(path);
+        if (known == paths.end()) {
+            return nullptr;
+        }
+        hash = known->second;
+        return acquire(hash);
+    }
+
+    // no reference added, for holders of one
+    T* find(uint64_t hash){
+        auto entry = entries.find(hash);
+        return entry == entries.end() ? nullptr : &entry->second.value;
+    }
+
+    // first reference of a new entry
+    T* insert(uint64_t hash, const std::string &path, const T &value){
+        Entry &entry = entries[hash];
+        entry.value = value;
+        entry.refCount = 1;
+        addPath(hash, path);
+        return &entry.value;
+    }
+    void addPath(uint64_t hash, const std::string &path){
+        auto entry = entries.find(hash);
+        if (entry == entries.end() || path.empty()) {
+            return;
+        }
+        auto known = paths.find(path);
+        if (known != paths.end() && known->second == hash) {
+            return;
+        }
+        paths[path] = hash;
+        entry->second.paths.push_back(path);
+    }
+
+    // drops a reference. Returns true with the value when it was the last one, the entry and its paths
+    // are gone then.
+    bool release(uint64_t hash, T &value, std::vector<std::string> *releasedPaths = nullptr){
+        auto entry = entries.find(hash);
+        if (entry == entries.end() || --entry->second.refCount > 0) {
+            return false;
+        }
+        value = entry->second.value;
+        if (releasedPaths != nullptr) {
+            *releasedPaths = entry->second.paths;
+        }
+        for (auto &path : entry->second.paths) {
+            auto known = paths.find(path);
+            if (known != paths.end() && known->second == hash) {
+                paths.erase(known);
+            }
+        }
+        entries.erase(entry);
+        return true;
+    }
+
+    // empties the cache regardless of references, for shutdown
+    void drain(std::vector<T> &values){
+        for (auto &entry : entries) {
+            values.push_back(entry.second.value);
+        }
+        entries.clear();
+        paths.clear();
+    }
+
+    size_t getSize(){
+        return entries.size();
+    }
+    // acquires that found an existing entry
+    uint64_t getHitCount(){
+        return hits;
+    }
+
+private:
+    struct Entry {
+        T value;
+        uint32_t refCount = 0;
+        std::vector<std::string> paths;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    std::unordered_map<std::string, uint64_t> paths;
+    uint64_t hits = 0;
+};
+
+#endif /* AssetCache_hpp */
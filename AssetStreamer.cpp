@@ -0,0 +1,300 @@
+#include "AssetStreamer.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "stb_image.h"
+#include "tiny_obj_loader.h"
+
+AssetStreamer::AssetStreamer(){}
+
+void AssetStreamer::start(uint32_t workerCount, JobSystem *newJobSystem){
+    jobSystem = newJobSystem;
+    workerCount = std::max(workerCount, 1u);
+    decodeLimit = workerCount;
+    
+    ioThread = std::thread(&AssetStreamer::ioLoop, this);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&AssetStreamer::workerLoop, this);
+    }
+}
+
+void AssetStreamer::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ioCondition.notify_all();
+    workerCondition.notify_all();
+    
+    if (ioThread.joinable()) {
+        ioThread.join();
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    
+    pending.clear();
+    decodeQueue.clear();
+    completed.clear();
+}
+
+uint64_t AssetStreamer::request(const std::string &modelFile, const std::string &textureFile, float priority){
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = nextRequest++;
+        pending.push_back({ id, modelFile, textureFile, priority });
+    }
+    ioCondition.notify_one();
+    return id;
+}
+
+void AssetStreamer::setPriorities(const std::pair<uint64_t, float> *priorities, size_t count){
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &request : pending) {
+        for (size_t i = 0; i < count; i++) {
+            if (priorities[i].first == request.id) {
+                request.priority = priorities[i].second;
+                break;
+            }
+        }
+    }
+}
+
+void AssetStreamer::cancel(uint64_t request){
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                 [request](const Request &pendingRequest) { return pendingRequest.id == request; }),
+                  pending.end());
+}
+
+void AssetStreamer::collect(std::vector<Result> &results, size_t maxResults){
+    std::lock_guard<std::mutex> lock(mutex);
+    if (completed.empty()) {
+        return;
+    }
+    
+    // a few at a time, the render thread uploads what it collects within the frame
+    size_t count = std::min(maxResults, completed.size());
+    std::partial_sort(completed.begin(), completed.begin() + count, completed.end(),
+                      [](const std::pair<float, Result> &a, const std::pair<float, Result> &b) { return a.first < b.first; });
+    for (size_t i = 0; i < count; i++) {
+        results.push_back(std::move(completed[i].second));
+    }
+    completed.erase(completed.begin(), completed.begin() + count);
+}
+
+void AssetStreamer::addResidentTexture(const std::string &file){
+    std::lock_guard<std::mutex> lock(mutex);
+    residentTextures.insert(file);
+}
+
+void AssetStreamer::removeResidentTexture(const std::string &file){
+    std::lock_guard<std::mutex> lock(mutex);
+    residentTextures.erase(file);
+}
+
+bool AssetStreamer::isResident(const std::string &file){
+    std::lock_guard<std::mutex> lock(mutex);
+    return residentTextures.count(file) > 0;
+}
+
+size_t AssetStreamer::getOutstandingCount(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending.size() + (reading ? 1 : 0) + decodeQueue.size() + decoding + completed.size();
+}
+
+void AssetStreamer::ioLoop(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        ioCondition.wait(lock, [this] { return stopping || (!pending.empty() && decodeQueue.size() < decodeLimit); });
+        if (stopping) {
+            return;
+        }
+        
+        // priorities change while requests wait, so the queue is searched instead of kept as a heap
+        auto next = std::min_element(pending.begin(), pending.end(),
+                                     [](const Request &a, const Request &b) { return a.priority < b.priority; });
+        ReadJob job;
+        job.request = *next;
+        pending.erase(next);
+        reading = true;
+        
+        lock.unlock();
+        std::string error;
+        bool success = read(job, error);
+        lock.lock();
+        
+        reading = false;
+        if (success) {
+            decodeQueue.push_back(std::move(job));
+            workerCondition.notify_one();
+        } else {
+            Result result;
+            result.request = job.request.id;
+            result.error = error;
+            completed.emplace_back(job.request.priority, std::move(result));
+        }
+    }
+}
+
+void AssetStreamer::workerLoop(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        workerCondition.wait(lock, [this] { return stopping || !decodeQueue.empty(); });
+        if (stopping) {
+            return;
+        }
+        
+        ReadJob job = std::move(decodeQueue.front());
+        decodeQueue.pop_front();
+        decoding++;
+        // room for the next read
+        ioCondition.notify_one();
+        
+        lock.unlock();
+        Result result;
+        decode(job, result);
+        lock.lock();
+        
+        decoding--;
+        completed.emplace_back(job.request.priority, std::move(result));
+    }
+}
+
+bool AssetStreamer::read(ReadJob &job, std::string &error){
+    if (!readFile(job.request.modelFile, job.modelData)) {
+        error = "failed to read " + job.request.modelFile;
+        return false;
+    }
+    
+    // material libraries and textures are relative to the OBJ
+    std::string baseDir;
+    size_t slash = job.request.modelFile.find_last_of('/');
+    if (slash != std::string::npos) {
+        baseDir = job.request.modelFile.substr(0, slash + 1);
+    }
+    
+    std::istringstream objStream(job.modelData);
+    std::string line;
+    while (std::getline(objStream, line)) {
+        if (line.compare(0, 7, "mtllib ") != 0) {
+            continue;
+        }
+        // a missing library leaves its materials untextured, like tinyobj does
+        std::istringstream names(line.substr(7));
+        std::string name;
+        while (names >> name) {
+            std::string mtlData;
+            if (readFile(baseDir + name, mtlData)) {
+                job.mtlData += mtlData + "\n";
+            }
+        }
+    }
+    
+    if (!job.request.textureFile.empty()) {
+        job.defaultTexture = 0;
+        job.textureFiles.push_back(job.request.textureFile);
+    }
+    
+    std::map<std::string, int> materialMap;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    std::istringstream mtlStream(job.mtlData);
+    tinyobj::LoadMtl(&materialMap, &materials, &mtlStream, &warn, &err);
+    
+    // textures shared by several materials are read once
+    for (const auto &material : materials) {
+        if (material.diffuse_texname.empty()) {
+            job.materialTextures.push_back(job.defaultTexture);
+            continue;
+        }
+        std::string file = baseDir + material.diffuse_texname;
+        auto known = std::find(job.textureFiles.begin(), job.textureFiles.end(), file);
+        job.materialTextures.push_back(static_cast<int>(known - job.textureFiles.begin()));
+        if (known == job.textureFiles.end()) {
+            job.textureFiles.push_back(file);
+        }
+    }
+    
+    job.textureData.resize(job.textureFiles.size());
+    job.resident.resize(job.textureFiles.size());
+    for (size_t i = 0; i < job.textureFiles.size(); i++) {
+        job.resident[i] = isResident(job.textureFiles[i]);
+        if (!job.resident[i] && !readFile(job.textureFiles[i], job.textureData[i])) {
+            error = "failed to read " + job.textureFiles[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+void AssetStreamer::decode(ReadJob &job, Result &result){
+    result.request = job.request.id;
+    result.modelHash = hashCombine(hashContent(job.modelData.data(), job.modelData.size()),
+                                   hashContent(job.mtlData.data(), job.mtlData.size()));
+    
+    std::istringstream objStream(job.modelData);
+    std::istringstream mtlStream(job.mtlData);
+    if (!MeshModel::LoadSubMeshes(objStream, mtlStream, result.meshes, result.error, *jobSystem)) {
+        result.error = job.request.modelFile + ": " + result.error;
+        return;
+    }
+    for (auto &subMesh : result.meshes) {
+        bool known = subMesh.material >= 0 && subMesh.material < static_cast<int>(job.materialTextures.size());
+        subMesh.material = known ? job.materialTextures[subMesh.material] : job.defaultTexture;
+    }
+    
+    // every image is decoded by its own job, the first failure in file order is reported
+    result.textures.resize(job.textureFiles.size());
+    std::vector<std::string> errors(job.textureFiles.size());
+    jobSystem->parallelFor(static_cast<uint32_t>(job.textureFiles.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            TextureData &texture = result.textures[i];
+            texture.file = job.textureFiles[i];
+            texture.resident = job.resident[i];
+            if (texture.resident) {
+                continue;
+            }
+            
+            const std::string &data = job.textureData[i];
+            texture.hash = hashContent(data.data(), data.size());
+            
+            int texWidth, texHeight, texChannels;
+            stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data.data()),
+                                                    static_cast<int>(data.size()),
+                                                    &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+            if (!pixels) {
+                errors[i] = texture.file + ": " + stbi_failure_reason();
+                continue;
+            }
+            
+            texture.width = static_cast<uint32_t>(texWidth);
+            texture.height = static_cast<uint32_t>(texHeight);
+            texture.pixels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+            stbi_image_free(pixels);
+        }
+    });
+    
+    for (auto &error : errors) {
+        if (!error.empty()) {
+            result.error = error;
+            return;
+        }
+    }
+}
+
+bool AssetStreamer::readFile(const std::string &fileName, std::string &data){
+    std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    std::streamsize size = file.tellg();
+    data.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    return static_cast<bool>(file.read(&data[0], size));
+}
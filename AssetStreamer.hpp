@@ -0,0 +1,117 @@
+#ifndef AssetStreamer_hpp
+#define AssetStreamer_hpp
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+
+#include "Utilities.h"
+#include "AssetCache.hpp"
+#include "MeshModel.hpp"
+#include "JobSystem.hpp"
+
+// Loads model and texture files off the render thread. One I/O thread reads whole files, always taking the
+// pending request with the lowest priority value next (the renderer uses the camera distance). Besides the
+// OBJ it reads the material libraries and every texture they name, skipping textures marked resident.
+// A few workers parse the OBJ and decode the images, splitting the vertex deduplication and the images of a
+// model across the job system. Finished requests wait in a list until the render thread collects them and
+// uploads the results, so no Vulkan call happens here.
+class AssetStreamer{
+public:
+    struct TextureData {
+        std::string file;                       // as given, or relative to the OBJ for material textures
+        bool resident = false;                  // not read, the renderer has it under this path
+        uint64_t hash = 0;                      // content hash of the file
+        std::vector<unsigned char> pixels;      // RGBA8
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    // CPU side of a loaded model, or the error that stopped it
+    struct Result {
+        uint64_t request;
+        std::vector<SubMesh> meshes;            // material replaced by an index into textures, -1 for none
+        std::vector<TextureData> textures;
+        uint64_t modelHash = 0;                 // OBJ and material libraries
+        std::string error;
+    };
+
+    AssetStreamer();
+
+    // the streamer owns threads and locks, it is started in place rather than assigned.
+    // jobSystem has to keep running until stop() returned.
+    void start(uint32_t workerCount, JobSystem *newJobSystem);
+    void stop();
+
+    // textureFile is used by faces whose material has no diffuse texture and may be empty.
+    // Returns the request id, never 0.
+    uint64_t request(const std::string &modelFile, const std::string &textureFile, float priority);
+    // requests that are still queued are reordered, the others are already being loaded
+    void setPriorities(const std::pair<uint64_t, float> *priorities, size_t count);
+    // drops a queued request, one that is already read finishes and is handed out anyway
+    void cancel(uint64_t request);
+
+    // textures under these paths are not read, the renderer's cache resolves them
+    void addResidentTexture(const std::string &file);
+    void removeResidentTexture(const std::string &file);
+
+    // moves up to maxResults finished requests into results, nearest first
+    void collect(std::vector<Result> &results, size_t maxResults);
+    // queued, being read or decoded, or waiting to be collected
+    size_t getOutstandingCount();
+
+private:
+    struct Request {
+        uint64_t id;
+        std::string modelFile;
+        std::string textureFile;
+        float priority;
+    };
+
+    // file contents on their way to a worker
+    struct ReadJob {
+        Request request;
+        std::string modelData;
+        std::string mtlData;                    // every material library, concatenated
+        std::vector<int> materialTextures;      // texture index per material, -1 for none
+        int defaultTexture = -1;                // textureFile
+        std::vector<std::string> textureFiles;
+        std::vector<std::string> textureData;   // empty for resident textures
+        std::vector<bool> resident;
+    };
+
+    std::mutex mutex;
+    std::condition_variable ioCondition;        // new requests, or room in the decode queue
+    std::condition_variable workerCondition;    // new read jobs
+    bool stopping = false;
+
+    uint64_t nextRequest = 1;
+    std::vector<Request> pending;
+    std::deque<ReadJob> decodeQueue;
+    size_t decodeLimit = 1;                     // the I/O thread does not read further ahead, priorities stay current
+    bool reading = false;
+    size_t decoding = 0;
+    std::vector<std::pair<float, Result>> completed;
+    std::unordered_set<std::string> residentTextures;
+
+    std::thread ioThread;
+    std::vector<std::thread> workers;
+    JobSystem *jobSystem = nullptr;
+
+    void ioLoop();
+    void workerLoop();
+    bool read(ReadJob &job, std::string &error);
+    void decode(ReadJob &job, Result &result);
+    bool isResident(const std::string &file);
+    static bool readFile(const std::string &fileName, std::string &data);
+};
+
+#endif /* AssetStreamer_hpp */
@@ -0,0 +1,107 @@
+#include "ComputeScheduler.hpp"
+
+ComputeScheduler::ComputeScheduler(){}
+
+ComputeScheduler::ComputeScheduler(VkDevice newDevice, VkQueue computeQueue, const QueueFamilyIndices &indices,
+                                   uint32_t framesInFlight, bool preferAsync){
+    device = newDevice;
+    async = preferAsync && indices.computeFamily.value() != indices.graphicsFamily.value();
+    queueFamily = async ? indices.computeFamily.value() : indices.graphicsFamily.value();
+    
+    if (async) {
+        timeline.queue = computeQueue;
+        timeline.semaphore = createTimelineSemaphore(device);
+    }
+    
+    for (uint32_t i = 0; i < framesInFlight; i++) {
+        commandAllocators.push_back(LinearCommandAllocator(device, queueFamily));
+    }
+    commandBuffers.resize(framesInFlight, VK_NULL_HANDLE);
+}
+
+bool ComputeScheduler::isAsync(){
+    return async;
+}
+
+uint32_t ComputeScheduler::getQueueFamily(){
+    return queueFamily;
+}
+
+VkCommandBuffer ComputeScheduler::begin(uint32_t frame){
+    commandAllocators[frame].reset();
+    commandBuffers[frame] = commandAllocators[frame].allocate();
+    
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    
+    if (vkBeginCommandBuffer(commandBuffers[frame], &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording compute commands.");
+    }
+    
+    return commandBuffers[frame];
+}
+
+void ComputeScheduler::end(uint32_t frame, VkPipelineStageFlags consumerStage, VkAccessFlags consumerAccess, SubmitBatch &graphicsBatch){
+    VkCommandBuffer commandBuffer = commandBuffers[frame];
+    
+    if (!async) {
+        // same queue: an ordinary barrier makes the results visible to the graphics work behind it
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = consumerAccess;
+        
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, consumerStage, 0,
+                             1, &barrier,
+                             0, nullptr,
+                             0, nullptr);
+    }
+    
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record compute commands.");
+    }
+    
+    if (!async) {
+        graphicsBatch.commandBuffers.insert(graphicsBatch.commandBuffers.begin(), commandBuffer);
+        return;
+    }
+    
+    // semaphore signal and wait carry the memory dependency across queues
+    uint64_t signalValue = ++timeline.lastSubmitted;
+    
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
+    
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline.semaphore;
+    
+    if (vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit compute commands.");
+    }
+    
+    graphicsBatch.waitSemaphores.push_back(timeline.semaphore);
+    graphicsBatch.waitStages.push_back(consumerStage);
+    graphicsBatch.waitValues.push_back(signalValue);
+}
+
+QueueTimeline& ComputeScheduler::getTimeline(){
+    return timeline;
+}
+
+void ComputeScheduler::destroy(){
+    for (auto &allocator : commandAllocators) {
+        allocator.destroy();
+    }
+    if (async) {
+        vkDestroySemaphore(device, timeline.semaphore, getHostCallbacks());
+    }
+}
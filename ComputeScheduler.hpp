@@ -0,0 +1,50 @@
+#ifndef ComputeScheduler_hpp
+#define ComputeScheduler_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include "Utilities.h"
+
+// Places per-frame compute work either on an async compute queue, where it overlaps the previous
+// frame's graphics and the graphics submission waits on the compute timeline, or inline at the start
+// of the graphics submission. Devices without a compute-only family (lavapipe, most integrated GPUs)
+// always get the inline path.
+class ComputeScheduler{
+public:
+    ComputeScheduler();
+    ComputeScheduler(VkDevice device, VkQueue computeQueue, const QueueFamilyIndices &indices,
+                     uint32_t framesInFlight, bool preferAsync);
+    
+    bool isAsync();
+    // family the resources touched by compute work have to be shared with
+    uint32_t getQueueFamily();
+    
+    // returns a recording command buffer for the frame's compute work. Only valid once the frame's
+    // previous graphics submission has finished.
+    VkCommandBuffer begin(uint32_t frame);
+    // finishes the frame's compute work. Async it is submitted right away and graphics waits at
+    // consumerStage; inline it gets a barrier and goes first in the graphics batch.
+    void end(uint32_t frame, VkPipelineStageFlags consumerStage, VkAccessFlags consumerAccess, SubmitBatch &graphicsBatch);
+    
+    QueueTimeline& getTimeline();
+    
+    void destroy();
+    
+private:
+    VkDevice device;
+    bool async = false;
+    uint32_t queueFamily;
+    
+    QueueTimeline timeline;
+    std::vector<LinearCommandAllocator> commandAllocators;      // one per frame in flight
+    std::vector<VkCommandBuffer> commandBuffers;                // recording per frame in flight
+};
+
+#endif /* ComputeScheduler_hpp */
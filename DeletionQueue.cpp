@@ -0,0 +1,120 @@
+#include "DeletionQueue.hpp"
+
+#include "HostAllocator.hpp"
+
+DeletionQueue::DeletionQueue(){}
+
+DeletionQueue::DeletionQueue(VkDevice newDevice){
+    device = newDevice;
+}
+
+DeletionQueue::Entry& DeletionQueue::push(Kind kind, uint64_t value){
+    Entry entry = {};
+    entry.value = value;
+    entry.kind = kind;
+    entries.push_back(entry);
+    
+    return entries.back();
+}
+
+void DeletionQueue::destroyBuffer(VkBuffer buffer, uint64_t value){
+    push(Kind::Buffer, value).buffer = buffer;
+}
+
+void DeletionQueue::destroyImage(VkImage image, uint64_t value){
+    push(Kind::Image, value).image = image;
+}
+
+void DeletionQueue::destroyImageView(VkImageView imageView, uint64_t value){
+    push(Kind::ImageView, value).imageView = imageView;
+}
+
+void DeletionQueue::freeMemory(VkDeviceMemory memory, uint64_t value){
+    push(Kind::Memory, value).memory = memory;
+}
+
+void DeletionQueue::freeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descriptorSet, uint64_t value){
+    Entry &entry = push(Kind::DescriptorSet, value);
+    entry.descriptorSet = descriptorSet;
+    entry.descriptorPool = pool;
+}
+
+void DeletionQueue::destroyFramebuffer(VkFramebuffer framebuffer, uint64_t value){
+    push(Kind::Framebuffer, value).framebuffer = framebuffer;
+}
+
+void DeletionQueue::destroyRenderPass(VkRenderPass renderPass, uint64_t value){
+    push(Kind::RenderPass, value).renderPass = renderPass;
+}
+
+void DeletionQueue::destroyPipeline(VkPipeline pipeline, uint64_t value){
+    push(Kind::Pipeline, value).pipeline = pipeline;
+}
+
+void DeletionQueue::destroyPipelineLayout(VkPipelineLayout pipelineLayout, uint64_t value){
+    push(Kind::PipelineLayout, value).pipelineLayout = pipelineLayout;
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain, uint64_t value){
+    push(Kind::Swapchain, value).swapchain = swapchain;
+}
+
+void DeletionQueue::flush(uint64_t completedValue){
+    if (entries.empty()) {
+        return;
+    }
+    
+    // values are not pushed in order, so compact the whole list and keep the order of what is left
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].value <= completedValue) {
+            destroyEntry(entries[i]);
+        } else {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+}
+
+size_t DeletionQueue::getPendingCount(){
+    return entries.size();
+}
+
+void DeletionQueue::destroy(){
+    flush(UINT64_MAX);
+}
+
+void DeletionQueue::destroyEntry(const Entry &entry){
+    switch (entry.kind) {
+        case Kind::Buffer:
+            vkDestroyBuffer(device, entry.buffer, getHostCallbacks());
+            break;
+        case Kind::Image:
+            vkDestroyImage(device, entry.image, getHostCallbacks());
+            break;
+        case Kind::ImageView:
+            vkDestroyImageView(device, entry.imageView, getHostCallbacks());
+            break;
+        case Kind::Memory:
+            vkFreeMemory(device, entry.memory, getHostCallbacks());
+            break;
+        case Kind::DescriptorSet:
+            vkFreeDescriptorSets(device, entry.descriptorPool, 1, &entry.descriptorSet);
+            break;
+        case Kind::Framebuffer:
+            vkDestroyFramebuffer(device, entry.framebuffer, getHostCallbacks());
+            break;
+        case Kind::RenderPass:
+            vkDestroyRenderPass(device, entry.renderPass, getHostCallbacks());
+            break;
+        case Kind::Pipeline:
+            vkDestroyPipeline(device, entry.pipeline, getHostCallbacks());
+            break;
+        case Kind::PipelineLayout:
+            vkDestroyPipelineLayout(device, entry.pipelineLayout, getHostCallbacks());
+            break;
+        case Kind::Swapchain:
+            vkDestroySwapchainKHR(device, entry.swapchain, getHostCallbacks());
+            break;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef DeletionQueue_hpp
+#define DeletionQueue_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <cstdint>
+#include <vector>
+
+// Defers destruction of GPU objects until the GPU is done with them. Each object is queued with the graphics
+// timeline value of the last submit that may reference it, flush() destroys everything whose value has been
+// reached. Objects queued together are destroyed in the order they were queued (views before images, images
+// before their memory).
+class DeletionQueue{
+public:
+    DeletionQueue();
+    DeletionQueue(VkDevice device);
+    
+    void destroyBuffer(VkBuffer buffer, uint64_t value);
+    void destroyImage(VkImage image, uint64_t value);
+    void destroyImageView(VkImageView imageView, uint64_t value);
+    void freeMemory(VkDeviceMemory memory, uint64_t value);
+    void freeDescriptorSet(VkDescriptorPool pool, VkDescriptorSet descriptorSet, uint64_t value);
+    void destroyFramebuffer(VkFramebuffer framebuffer, uint64_t value);
+    void destroyRenderPass(VkRenderPass renderPass, uint64_t value);
+    void destroyPipeline(VkPipeline pipeline, uint64_t value);
+    void destroyPipelineLayout(VkPipelineLayout pipelineLayout, uint64_t value);
+    void destroySwapchain(VkSwapchainKHR swapchain, uint64_t value);
+    
+    // destroys every object whose timeline value is at most completedValue
+    void flush(uint64_t completedValue);
+    size_t getPendingCount();
+    
+    // only valid once the device is idle
+    void destroy();
+    
+private:
+    enum class Kind {
+        Buffer,
+        Image,
+        ImageView,
+        Memory,
+        DescriptorSet,
+        Framebuffer,
+        RenderPass,
+        Pipeline,
+        PipelineLayout,
+        Swapchain
+    };
+    
+    struct Entry {
+        uint64_t value;
+        Kind kind;
+        union {
+            VkBuffer buffer;
+            VkImage image;
+            VkImageView imageView;
+            VkDeviceMemory memory;
+            VkDescriptorSet descriptorSet;
+            VkFramebuffer framebuffer;
+            VkRenderPass renderPass;
+            VkPipeline pipeline;
+            VkPipelineLayout pipelineLayout;
+            VkSwapchainKHR swapchain;
+        };
+        VkDescriptorPool descriptorPool;    // owner of descriptorSet
+    };
+    
+    VkDevice device = VK_NULL_HANDLE;
+    std::vector<Entry> entries;
+    
+    Entry& push(Kind kind, uint64_t value);
+    void destroyEntry(const Entry &entry);
+};
+
+#endif /* DeletionQueue_hpp */
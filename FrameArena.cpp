@@ -0,0 +1,46 @@
+#include "FrameArena.hpp"
+
+#include <stdexcept>
+
+FrameArena::FrameArena(){}
+
+FrameArena::FrameArena(size_t newCapacity){
+    capacity = newCapacity;
+    block.reset(new char[capacity]);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment){
+    if (alignment > alignof(std::max_align_t)) {
+        throw std::runtime_error("frame arena alignment exceeds the heap's.");
+    }
+    
+    size_t offset = (used + alignment - 1) & ~(alignment - 1);
+    if (offset + size <= capacity) {
+        used = offset + size;
+        return block.get() + offset;
+    }
+    
+    // the heap block is aligned for anything, the frame keeps it until reset
+    spills.emplace_back(new char[size]);
+    spilledBytes += size;
+    return spills.back().get();
+}
+
+void FrameArena::reset(){
+    if (!spills.empty()) {
+        // room for the whole frame and some headroom
+        capacity = (used + spilledBytes) * 3 / 2;
+        block.reset(new char[capacity]);
+        spills.clear();
+        spilledBytes = 0;
+    }
+    used = 0;
+}
+
+size_t FrameArena::getUsed(){
+    return used + spilledBytes;
+}
+
+size_t FrameArena::getCapacity(){
+    return capacity;
+}
@@ -0,0 +1,78 @@
+#ifndef FrameArena_hpp
+#define FrameArena_hpp
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+
+// Bump allocator for CPU data that lives no longer than one frame in flight: submit infos, barrier arrays
+// and other temporaries of the draw loop. Nothing is freed one by one, reset() at frame start releases
+// everything at once. A frame that outgrows the block spills into separate heap blocks and the next reset()
+// replaces them with one block large enough for it, so a steady workload stops allocating after a frame.
+// Render thread only.
+class FrameArena{
+public:
+    FrameArena();
+    explicit FrameArena(size_t capacity);
+
+    // alignment up to alignof(std::max_align_t)
+    void* allocate(size_t size, size_t alignment);
+    // everything handed out since the last reset becomes invalid
+    void reset();
+
+    // bytes handed out since the last reset, spills included
+    size_t getUsed();
+    size_t getCapacity();
+
+private:
+    std::unique_ptr<char[]> block;
+    size_t capacity = 0;
+    size_t used = 0;
+    std::vector<std::unique_ptr<char[]>> spills;
+    size_t spilledBytes = 0;
+};
+
+// STL allocator over a FrameArena, deallocation is a no-op
+template<typename T>
+class ArenaAllocator{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena &newArena) : arena(&newArena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.getArena()) {}
+
+    T* allocate(size_t count){
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T*, size_t){}
+
+    FrameArena* getArena() const{
+        return arena;
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const{
+        return arena == other.getArena();
+    }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const{
+        return arena != other.getArena();
+    }
+
+private:
+    FrameArena *arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template<typename Key, typename Value>
+using ArenaMap = std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>, ArenaAllocator<std::pair<const Key, Value>>>;
+
+#endif /* FrameArena_hpp */
@@ -0,0 +1,101 @@
+#ifndef HandlePool_hpp
+#define HandlePool_hpp
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Index into a HandlePool plus the generation of the slot at creation time. Removing an element bumps the
+// slot's generation, so handles to it go stale instead of silently pointing at whatever reuses the slot.
+// The tag keeps handles of different pools from being mixed up.
+template<typename Tag>
+struct Handle {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool isNull() const { return index == UINT32_MAX; }
+    bool operator==(const Handle &other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Handle &other) const { return !(*this == other); }
+};
+
+// Slot array with a free list. Removed slots are reused before the array grows, so its size is bounded by
+// the peak number of live elements rather than by the number ever inserted.
+template<typename T, typename Tag>
+class HandlePool{
+public:
+    typedef Handle<Tag> HandleType;
+
+    HandleType insert(const T &value){
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            values[index] = value;
+        } else {
+            index = static_cast<uint32_t>(values.size());
+            values.push_back(value);
+            generations.push_back(0);
+            alive.push_back(false);
+        }
+        alive[index] = true;
+        liveCount++;
+
+        HandleType handle;
+        handle.index = index;
+        handle.generation = generations[index];
+        return handle;
+    }
+
+    bool contains(HandleType handle){
+        return handle.index < values.size() && alive[handle.index] && generations[handle.index] == handle.generation;
+    }
+
+    // nullptr for stale or null handles
+    T* get(HandleType handle){
+        return contains(handle) ? &values[handle.index] : nullptr;
+    }
+
+    bool remove(HandleType handle){
+        if (!contains(handle)) {
+            return false;
+        }
+        values[handle.index] = T();
+        alive[handle.index] = false;
+        generations[handle.index]++;
+        freeSlots.push_back(handle.index);
+        liveCount--;
+        return true;
+    }
+
+    // slot level access for iteration, dead slots hold a default constructed T
+    uint32_t getSlotCount(){
+        return static_cast<uint32_t>(values.size());
+    }
+    bool isAlive(uint32_t index){
+        return alive[index];
+    }
+    T& at(uint32_t index){
+        return values[index];
+    }
+    HandleType getHandle(uint32_t index){
+        HandleType handle;
+        handle.index = index;
+        handle.generation = generations[index];
+        return handle;
+    }
+
+    uint32_t getSize(){
+        return liveCount;
+    }
+
+private:
+    std::vector<T> values;
+    std::vector<uint32_t> generations;
+    std::vector<bool> alive;
+    std::vector<uint32_t> freeSlots;
+    uint32_t liveCount = 0;
+};
+
+#endif /* HandlePool_hpp */
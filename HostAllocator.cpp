@@ -0,0 +1,203 @@
+#include "HostAllocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+HostAllocator::HostAllocator(){
+    callbacks.pUserData = this;
+    callbacks.pfnAllocation = &HostAllocator::allocationFunction;
+    callbacks.pfnReallocation = &HostAllocator::reallocationFunction;
+    callbacks.pfnFree = &HostAllocator::freeFunction;
+    callbacks.pfnInternalAllocation = &HostAllocator::internalAllocationNotification;
+    callbacks.pfnInternalFree = &HostAllocator::internalFreeNotification;
+}
+
+HostAllocator::~HostAllocator(){
+    for (auto &pool : pools) {
+        for (void *chunk : pool.chunks) {
+            std::free(chunk);
+        }
+    }
+}
+
+void HostAllocator::setEnabled(bool newEnabled){
+    enabled = newEnabled;
+}
+
+const VkAllocationCallbacks* HostAllocator::getCallbacks(){
+    return enabled ? &callbacks : nullptr;
+}
+
+HostAllocator::Stats HostAllocator::getStats(){
+    Stats stats;
+    for (uint32_t i = 0; i < SCOPE_COUNT; i++) {
+        stats.liveBytes[i] = scopes[i].liveBytes.load(std::memory_order_relaxed);
+        stats.liveAllocations[i] = scopes[i].liveAllocations.load(std::memory_order_relaxed);
+        stats.allocations[i] = scopes[i].allocations.load(std::memory_order_relaxed);
+        stats.internalBytes[i] = scopes[i].internalBytes.load(std::memory_order_relaxed);
+    }
+    stats.pooledBytes = pooledBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope){
+    if (size == 0) {
+        return nullptr;
+    }
+    
+    // the header sits right before the allocation, an alignment of at least its size leaves room for it
+    alignment = std::max(alignment, sizeof(Header));
+    size_t offset = alignment;
+    size_t total = offset + size;
+    
+    // power of two slots in 4 KB aligned chunks are aligned to their size, which covers the alignment
+    uint16_t sizeClass = LARGE;
+    void *slot = nullptr;
+    if (total <= MAX_SLOT_SIZE) {
+        sizeClass = 0;
+        while ((MIN_SLOT_SIZE << sizeClass) < total) {
+            sizeClass++;
+        }
+        slot = takeSlot(sizeClass);
+    } else {
+        slot = std::aligned_alloc(alignment, (total + alignment - 1) / alignment * alignment);
+    }
+    if (slot == nullptr) {
+        return nullptr;                                 // the driver reports VK_ERROR_OUT_OF_HOST_MEMORY
+    }
+    
+    void *memory = static_cast<char*>(slot) + offset;
+    Header *header = getHeader(memory);
+    header->size = size;
+    header->offset = static_cast<uint32_t>(offset);
+    header->sizeClass = sizeClass;
+    header->scope = static_cast<uint16_t>(std::min<uint32_t>(scope, SCOPE_COUNT - 1));
+    
+    ScopeCounters &counters = scopes[header->scope];
+    counters.liveBytes.fetch_add(size, std::memory_order_relaxed);
+    counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    return memory;
+}
+
+void* HostAllocator::reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope){
+    if (original == nullptr) {
+        return allocate(size, alignment, scope);
+    }
+    if (size == 0) {
+        free(original);
+        return nullptr;
+    }
+    
+    // the alignment is the original one, so a slot with room left keeps the allocation in place
+    Header *header = getHeader(original);
+    if (header->sizeClass != LARGE && header->offset + size <= (MIN_SLOT_SIZE << header->sizeClass)) {
+        ScopeCounters &counters = scopes[header->scope];
+        counters.liveBytes.fetch_add(size, std::memory_order_relaxed);
+        counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+        counters.allocations.fetch_add(1, std::memory_order_relaxed);
+        header->size = size;
+        return original;
+    }
+    
+    // on failure the original stays valid
+    void *memory = allocate(size, alignment, scope);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+    std::memcpy(memory, original, std::min<size_t>(size, header->size));
+    free(original);
+    return memory;
+}
+
+void HostAllocator::free(void *memory){
+    if (memory == nullptr) {
+        return;
+    }
+    
+    Header *header = getHeader(memory);
+    ScopeCounters &counters = scopes[header->scope];
+    counters.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+    counters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    
+    void *slot = static_cast<char*>(memory) - header->offset;
+    if (header->sizeClass == LARGE) {
+        std::free(slot);
+    } else {
+        returnSlot(header->sizeClass, slot);
+    }
+}
+
+void* HostAllocator::takeSlot(uint16_t sizeClass){
+    Pool &pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    
+    if (pool.freeList == nullptr) {
+        char *chunk = static_cast<char*>(std::aligned_alloc(MAX_SLOT_SIZE, CHUNK_SIZE));
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+        pool.chunks.push_back(chunk);
+        pooledBytes.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+        
+        // threaded back to front, so slots are handed out in address order
+        size_t slotSize = MIN_SLOT_SIZE << sizeClass;
+        for (size_t offset = CHUNK_SIZE; offset >= slotSize; offset -= slotSize) {
+            void *slot = chunk + offset - slotSize;
+            *static_cast<void**>(slot) = pool.freeList;
+            pool.freeList = slot;
+        }
+    }
+    
+    void *slot = pool.freeList;
+    pool.freeList = *static_cast<void**>(slot);
+    return slot;
+}
+
+void HostAllocator::returnSlot(uint16_t sizeClass, void *slot){
+    Pool &pool = pools[sizeClass];
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    *static_cast<void**>(slot) = pool.freeList;
+    pool.freeList = slot;
+}
+
+HostAllocator::Header* HostAllocator::getHeader(void *memory){
+    return reinterpret_cast<Header*>(static_cast<char*>(memory) - sizeof(Header));
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::allocationFunction(void *userData, size_t size, size_t alignment,
+                                                              VkSystemAllocationScope scope){
+    return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL HostAllocator::reallocationFunction(void *userData, void *original, size_t size, size_t alignment,
+                                                                VkSystemAllocationScope scope){
+    return static_cast<HostAllocator*>(userData)->reallocate(original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::freeFunction(void *userData, void *memory){
+    static_cast<HostAllocator*>(userData)->free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalAllocationNotification(void *userData, size_t size, VkInternalAllocationType type,
+                                                                         VkSystemAllocationScope scope){
+    HostAllocator *allocator = static_cast<HostAllocator*>(userData);
+    allocator->scopes[std::min<uint32_t>(scope, SCOPE_COUNT - 1)].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+VKAPI_ATTR void VKAPI_CALL HostAllocator::internalFreeNotification(void *userData, size_t size, VkInternalAllocationType type,
+                                                                   VkSystemAllocationScope scope){
+    HostAllocator *allocator = static_cast<HostAllocator*>(userData);
+    allocator->scopes[std::min<uint32_t>(scope, SCOPE_COUNT - 1)].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+HostAllocator& getHostAllocator(){
+    // constructed on first use, destroyed after main returned and the renderer cleaned up
+    static HostAllocator allocator;
+    return allocator;
+}
+
+const VkAllocationCallbacks* getHostCallbacks(){
+    return getHostAllocator().getCallbacks();
+}
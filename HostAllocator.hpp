@@ -0,0 +1,104 @@
+#ifndef HostAllocator_hpp
+#define HostAllocator_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// VkAllocationCallbacks that serve the driver's host memory. Requests up to 4 KB come from size-class pools:
+// freed slots go back to a free list of their class and chunks are only returned in the destructor, so the
+// small allocations a driver makes while recording and creating objects stop reaching malloc. Larger ones go
+// to the heap. Every allocation is counted under its VkSystemAllocationScope. The driver may call in from any
+// thread, including the pipeline compile workers.
+class HostAllocator{
+public:
+    static const uint32_t SCOPE_COUNT = 5;      // VkSystemAllocationScope, command to instance
+
+    // per VkSystemAllocationScope
+    struct Stats {
+        std::array<uint64_t, SCOPE_COUNT> liveBytes{};          // requested sizes of the allocations alive now
+        std::array<uint64_t, SCOPE_COUNT> liveAllocations{};
+        std::array<uint64_t, SCOPE_COUNT> allocations{};        // allocate and reallocate calls so far
+        std::array<uint64_t, SCOPE_COUNT> internalBytes{};      // memory the driver got elsewhere and reported
+        uint64_t pooledBytes = 0;                               // chunks held by the pools
+    };
+
+    HostAllocator();
+    ~HostAllocator();
+
+    // before the first Vulkan call, an object has to be destroyed with the callbacks it was created with
+    void setEnabled(bool enabled);
+    // nullptr while disabled
+    const VkAllocationCallbacks* getCallbacks();
+    Stats getStats();
+
+private:
+    static const uint32_t SIZE_CLASS_COUNT = 8;         // slots of 32 bytes to 4 KB
+    static const size_t MIN_SLOT_SIZE = 32;
+    static const size_t MAX_SLOT_SIZE = MIN_SLOT_SIZE << (SIZE_CLASS_COUNT - 1);
+    static const size_t CHUNK_SIZE = 64 * 1024;
+    static const uint16_t LARGE = 0xffff;               // sizeClass of allocations from the heap
+
+    // right before every allocation. offset leads from the slot to the allocation and keeps it aligned.
+    struct Header {
+        uint64_t size;
+        uint32_t offset;
+        uint16_t sizeClass;
+        uint16_t scope;
+    };
+
+    struct Pool {
+        std::mutex mutex;
+        void *freeList = nullptr;                       // the first bytes of a free slot point to the next
+        std::vector<void*> chunks;
+    };
+
+    struct ScopeCounters {
+        std::atomic<uint64_t> liveBytes{0};
+        std::atomic<uint64_t> liveAllocations{0};
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> internalBytes{0};
+    };
+
+    VkAllocationCallbacks callbacks{};
+    bool enabled = false;
+    std::array<Pool, SIZE_CLASS_COUNT> pools;
+    std::array<ScopeCounters, SCOPE_COUNT> scopes;
+    std::atomic<uint64_t> pooledBytes{0};
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void* reallocate(void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+    void free(void *memory);
+    void* takeSlot(uint16_t sizeClass);
+    void returnSlot(uint16_t sizeClass, void *slot);
+    static Header* getHeader(void *memory);
+
+    static VKAPI_ATTR void* VKAPI_CALL allocationFunction(void *userData, size_t size, size_t alignment,
+                                                          VkSystemAllocationScope scope);
+    static VKAPI_ATTR void* VKAPI_CALL reallocationFunction(void *userData, void *original, size_t size, size_t alignment,
+                                                            VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL freeFunction(void *userData, void *memory);
+    static VKAPI_ATTR void VKAPI_CALL internalAllocationNotification(void *userData, size_t size, VkInternalAllocationType type,
+                                                                     VkSystemAllocationScope scope);
+    static VKAPI_ATTR void VKAPI_CALL internalFreeNotification(void *userData, size_t size, VkInternalAllocationType type,
+                                                               VkSystemAllocationScope scope);
+};
+
+// the process wide allocator. Vulkan objects are created by the renderer, the streamer's uploads and the
+// pipeline workers alike, so every create and destroy call passes getHostCallbacks().
+HostAllocator& getHostAllocator();
+const VkAllocationCallbacks* getHostCallbacks();
+
+#endif /* HostAllocator_hpp */
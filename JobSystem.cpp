@@ -0,0 +1,268 @@
+#include "JobSystem.hpp"
+
+#include <algorithm>
+
+// the queue of the calling thread when it is one of this job system's workers
+static thread_local JobSystem *currentJobSystem = nullptr;
+static thread_local uint32_t currentQueue = 0;
+// the queue claimed by the calling thread when it is not a worker, by job system id since a job system may
+// be created where an earlier one was destroyed
+static thread_local uint64_t submitterSystem = 0;
+static thread_local uint32_t submitterQueue = 0;
+
+static std::atomic<uint64_t> nextSystemId{1};
+
+bool JobSystem::Counter::isDone(){
+    return pending.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(){
+    id = nextSystemId.fetch_add(1);
+    
+    // allocated up front, workers look through them while other threads claim theirs
+    for (uint32_t i = 0; i < SUBMITTER_QUEUES; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+}
+
+void JobSystem::start(uint32_t workerCount){
+    if (workerCount == 0) {
+        workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    }
+    
+    // every queue exists before the first worker looks for work to steal
+    for (uint32_t i = 0; i < workerCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&JobSystem::workerLoop, this, SUBMITTER_QUEUES + i);
+    }
+}
+
+void JobSystem::stop(){
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+    
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    
+    // submitting threads keep the queues they claimed
+    queues.resize(SUBMITTER_QUEUES);
+    for (auto &queue : queues) {
+        queue->jobs.clear();
+        queue->head = 0;
+        queue->count = 0;
+    }
+    queuedJobs = 0;
+    stopping = false;
+}
+
+void JobSystem::run(std::function<void()> function, Counter *counter, Counter *dependency){
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    Job job = { std::move(function), counter };
+    if (dependency != nullptr) {
+        // finish() releases the continuations under the same lock, the job is either parked or runs now
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->isDone()) {
+            dependency->continuations.push_back(std::move(job));
+            return;
+        }
+    }
+    submit(std::move(job), false);
+}
+
+void JobSystem::wait(Counter &counter){
+    while (!counter.isDone()) {
+        if (!runOne()) {
+            std::this_thread::yield();
+        }
+    }
+    // the last job decrements under the lock, once it is released nothing touches the counter any more
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+uint32_t JobSystem::getWorkerCount(){
+    return static_cast<uint32_t>(workers.size());
+}
+
+uint64_t JobSystem::getStolenCount(){
+    return stolenJobs.load(std::memory_order_relaxed);
+}
+
+void JobSystem::workerLoop(uint32_t index){
+    currentJobSystem = this;
+    currentQueue = index;
+    
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        // counted before the check, so submit() either sees a sleeper or the worker sees the job
+        sleepingWorkers.fetch_add(1);
+        sleepCondition.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+        sleepingWorkers.fetch_sub(1);
+        if (stopping && queuedJobs.load() == 0) {
+            return;
+        }
+    }
+}
+
+void JobSystem::submit(Job job, bool released){
+    uint32_t index = getQueueIndex();
+    if (workers.empty()) {
+        job.function();
+        finish(job.counter);
+        return;
+    }
+    if (released && (index < SUBMITTER_QUEUES || index == NO_QUEUE)) {
+        // a continuation released by the last job of a counter is not the releasing thread's job. Left in the
+        // render thread's queue it would be run there by its next wait().
+        index = SUBMITTER_QUEUES + releasedJobs.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    } else if (index == NO_QUEUE) {
+        // nobody else would take it out of this thread's queue
+        job.function();
+        finish(job.counter);
+        return;
+    }
+    
+    Queue &queue = *queues[index];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack(std::move(job));
+    }
+    queuedJobs.fetch_add(1);
+    
+    if (sleepingWorkers.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        sleepCondition.notify_one();
+    }
+}
+
+bool JobSystem::runOne(){
+    Job job;
+    if (!pop(job)) {
+        return false;
+    }
+    job.function();
+    finish(job.counter);
+    return true;
+}
+
+bool JobSystem::pop(Job &job){
+    if (queuedJobs.load() == 0) {
+        return false;
+    }
+    
+    uint32_t own = getQueueIndex();
+    if (own == NO_QUEUE) {
+        return false;
+    }
+    if (own < SUBMITTER_QUEUES) {
+        // not a worker: only its own jobs, newest first. The workers drain everything else.
+        Queue &queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.popBack(job)) {
+            return false;
+        }
+        queuedJobs.fetch_sub(1);
+        return true;
+    }
+    
+    // own deque newest first, it is still in cache. Other queues oldest first, those jobs tend to be the larger
+    // pieces of a split.
+    uint32_t submitters = std::min(submitterCount.load(), SUBMITTER_QUEUES);
+    uint32_t queueCount = static_cast<uint32_t>(queues.size());
+    for (uint32_t i = 0; i < queueCount; i++) {
+        uint32_t index = (own + i) % queueCount;
+        if (index >= submitters && index < SUBMITTER_QUEUES) {
+            continue;
+        }
+        Queue &queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (i == 0) {
+            if (!queue.popBack(job)) {
+                continue;
+            }
+        } else {
+            if (!queue.popFront(job)) {
+                continue;
+            }
+            stolenJobs.fetch_add(1, std::memory_order_relaxed);
+        }
+        queuedJobs.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::finish(Counter *counter){
+    if (counter == nullptr) {
+        return;
+    }
+    
+    std::vector<Job> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            ready.swap(counter->continuations);
+        }
+    }
+    for (auto &job : ready) {
+        submit(std::move(job), true);
+    }
+}
+
+uint32_t JobSystem::getQueueIndex(){
+    if (currentJobSystem == this) {
+        return currentQueue;
+    }
+    if (submitterSystem != id) {
+        uint32_t index = submitterCount.fetch_add(1);
+        submitterSystem = id;
+        submitterQueue = index < SUBMITTER_QUEUES ? index : NO_QUEUE;
+    }
+    return submitterQueue;
+}
+
+void JobSystem::Queue::pushBack(Job job){
+    if (count == jobs.size()) {
+        // unwrapped into a buffer twice the size
+        std::vector<Job> grown(std::max<size_t>(jobs.size() * 2, 64));
+        for (size_t i = 0; i < count; i++) {
+            grown[i] = std::move(jobs[(head + i) % jobs.size()]);
+        }
+        jobs.swap(grown);
+        head = 0;
+    }
+    jobs[(head + count) % jobs.size()] = std::move(job);
+    count++;
+}
+
+bool JobSystem::Queue::popBack(Job &job){
+    if (count == 0) {
+        return false;
+    }
+    count--;
+    job = std::move(jobs[(head + count) % jobs.size()]);
+    return true;
+}
+
+bool JobSystem::Queue::popFront(Job &job){
+    if (count == 0) {
+        return false;
+    }
+    job = std::move(jobs[head]);
+    head = (head + 1) % jobs.size();
+    count--;
+    return true;
+}
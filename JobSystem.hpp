@@ -0,0 +1,131 @@
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Work-stealing scheduler for short CPU jobs. Every worker has its own deque: it pushes and pops jobs at the
+// back, idle workers steal from the front of the others. Every other thread that submits gets a queue of its
+// own the first time. A thread waiting on a counter runs jobs itself until the counter drops to zero, so jobs
+// may wait on jobs they spawned and any thread can call wait() without idling a core. A worker runs whatever
+// it finds, any other thread only takes back jobs from its own queue, so the render thread waiting on its
+// culling never ends up running a texture decode queued by the streamer. Jobs must not throw.
+class JobSystem{
+public:
+    // jobs in flight. Each job run with a counter holds it above zero until it returned, and jobs can be held
+    // back until a counter reached zero. Reusable once zero. It may only be destroyed after wait() returned.
+    class Counter{
+    public:
+        bool isDone();
+
+    private:
+        friend class JobSystem;
+        struct Job {
+            std::function<void()> function;
+            Counter *counter;
+        };
+
+        std::atomic<uint32_t> pending{0};
+        std::mutex mutex;
+        std::vector<Job> continuations;         // jobs waiting for pending to reach zero
+    };
+
+    JobSystem();
+
+    // the job system owns threads and locks, it is started in place rather than assigned.
+    // 0 workers picks the hardware thread count minus the calling thread.
+    void start(uint32_t workerCount);
+    // the workers finish the queued jobs first, jobs held back by a dependency are dropped
+    void stop();
+
+    // counter is incremented now and decremented when the job returned. With a dependency the job is queued
+    // once that counter is zero: on the thread that released it if that is a worker, else on a worker.
+    void run(std::function<void()> function, Counter *counter = nullptr, Counter *dependency = nullptr);
+    // runs queued jobs until the counter is zero, outside the workers only the ones this thread submitted
+    void wait(Counter &counter);
+    // body(begin, end) over [0, count) in chunks of grainSize, the calling thread takes part. Returns when
+    // every chunk ran.
+    template<typename Body>
+    void parallelFor(uint32_t count, uint32_t grainSize, const Body &body);
+
+    uint32_t getWorkerCount();
+    // jobs taken from another thread's deque
+    uint64_t getStolenCount();
+
+private:
+    typedef Counter::Job Job;
+
+    // ring buffer that grows but never shrinks, so a steady stream of jobs does not allocate
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Job> jobs;
+        size_t head = 0;
+        size_t count = 0;
+
+        void pushBack(Job job);
+        bool popBack(Job &job);
+        bool popFront(Job &job);
+    };
+
+    // queues for threads that are not workers, claimed on their first submit and kept. Past that many
+    // submitting threads the jobs run inline on the submitter.
+    static constexpr uint32_t SUBMITTER_QUEUES = 32;
+    static constexpr uint32_t NO_QUEUE = ~0u;
+
+    // the submitter queues first, then one per worker
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::atomic<uint32_t> submitterCount{0};
+    uint64_t id;                                // tells the submitter queue of this job system from an earlier one
+    std::vector<std::thread> workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<uint32_t> queuedJobs{0};
+    std::atomic<uint32_t> sleepingWorkers{0};
+    bool stopping = false;
+
+    std::atomic<uint64_t> stolenJobs{0};
+    std::atomic<uint32_t> releasedJobs{0};      // spreads continuations released outside the workers
+
+    void workerLoop(uint32_t index);
+    void submit(Job job, bool released);
+    bool runOne();
+    bool pop(Job &job);
+    void finish(Counter *counter);
+    uint32_t getQueueIndex();
+};
+
+template<typename Body>
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const Body &body){
+    if (count == 0) {
+        return;
+    }
+    grainSize = std::max(grainSize, 1u);
+    uint32_t chunkCount = (count - 1) / grainSize + 1;
+    if (chunkCount == 1 || workers.empty()) {
+        body(0, count);
+        return;
+    }
+    
+    // a pointer and the range fit std::function's local storage, splitting a loop does not allocate
+    const Body *bodyPointer = &body;
+    Counter counter;
+    for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+        uint32_t begin = chunk * grainSize;
+        uint32_t end = std::min(count - begin, grainSize) + begin;
+        run([bodyPointer, begin, end] { (*bodyPointer)(begin, end); }, &counter);
+    }
+    body(0, grainSize);
+    wait(counter);
+}
+
+#endif /* JobSystem_hpp */
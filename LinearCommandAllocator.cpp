@@ -0,0 +1,58 @@
+#include "LinearCommandAllocator.hpp"
+
+#include "HostAllocator.hpp"
+
+LinearCommandAllocator::LinearCommandAllocator(){}
+
+LinearCommandAllocator::LinearCommandAllocator(VkDevice newDevice, uint32_t queueFamilyIndex){
+    device = newDevice;
+    
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;     // short-lived buffers, no per-buffer reset
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+    
+    if (vkCreateCommandPool(device, &poolInfo, getHostCallbacks(), &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a transient command pool.");
+    }
+}
+
+void LinearCommandAllocator::reset(){
+    // releases every buffer's recorded commands at once, the buffers themselves stay allocated
+    vkResetCommandPool(device, commandPool, 0);
+    nextBuffer = 0;
+}
+
+VkCommandBuffer LinearCommandAllocator::allocate(){
+    if (nextBuffer == commandBuffers.size()) {
+        VkCommandBufferAllocateInfo cbAllocInfo = {};
+        cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cbAllocInfo.commandPool = commandPool;
+        cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cbAllocInfo.commandBufferCount = 1;
+        
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &cbAllocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate a transient command buffer.");
+        }
+        commandBuffers.push_back(commandBuffer);
+    }
+    
+    return commandBuffers[nextBuffer++];
+}
+
+uint32_t LinearCommandAllocator::getAllocatedCount(){
+    return nextBuffer;
+}
+
+uint32_t LinearCommandAllocator::getCapacity(){
+    return static_cast<uint32_t>(commandBuffers.size());
+}
+
+void LinearCommandAllocator::destroy(){
+    // destroying the pool frees all of its buffers
+    vkDestroyCommandPool(device, commandPool, getHostCallbacks());
+    commandPool = VK_NULL_HANDLE;
+    commandBuffers.clear();
+    nextBuffer = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef LinearCommandAllocator_hpp
+#define LinearCommandAllocator_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Hands out primary command buffers from a transient pool owned by one frame in flight.
+// Buffers are never freed or reset one by one: reset() recycles the whole pool once the frame's
+// work has finished on the GPU, and allocation restarts at the first buffer.
+class LinearCommandAllocator{
+public:
+    LinearCommandAllocator();
+    LinearCommandAllocator(VkDevice device, uint32_t queueFamilyIndex);
+    
+    // only valid once the GPU has finished every buffer handed out since the last reset
+    void reset();
+    VkCommandBuffer allocate();
+    
+    uint32_t getAllocatedCount();
+    uint32_t getCapacity();
+    
+    void destroy();
+    
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    
+    std::vector<VkCommandBuffer> commandBuffers;
+    uint32_t nextBuffer = 0;
+};
+
+#endif /* LinearCommandAllocator_hpp */
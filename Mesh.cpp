@@ -1,31 +1,57 @@
 #include "Mesh.hpp"
 
+#include <limits>
+
 Mesh::Mesh(){}
 
 Mesh::Mesh(VkPhysicalDevice newPhysicalDevice,
            VkDevice newDevice,
-           VkQueue transferQueue,
-           VkCommandPool transferCommandPool,
+           Uploader &uploader,
            const QueueFamilyIndices &queueFamilyIndices,
            const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indicies, int newTexId){
     indexCount = indicies.size();
     vertexCount = vertices.size();
     physicalDevice = newPhysicalDevice;
     device = newDevice;
-    createVertexBuffer(transferQueue, transferCommandPool, queueFamilyIndices, vertices);
-    createIndexBuffer(transferQueue, transferCommandPool, queueFamilyIndices, indicies);
+    createVertexBuffer(uploader, queueFamilyIndices, vertices);
+    createPositionBuffer(uploader, queueFamilyIndices, vertices);
+    createIndexBuffer(uploader, queueFamilyIndices, indicies);
     
-    model = glm::mat4(1.0f);
     texId = newTexId;
+    
+    // sphere around the AABB center, loose but cheap and stable
+    glm::vec3 minPos(std::numeric_limits<float>::max());
+    glm::vec3 maxPos(-std::numeric_limits<float>::max());
+    for (const Vertex &vertex : vertices) {
+        minPos = glm::min(minPos, vertex.pos);
+        maxPos = glm::max(maxPos, vertex.pos);
+    }
+    glm::vec3 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.0f;
+    for (const Vertex &vertex : vertices) {
+        radius = std::max(radius, glm::length(vertex.pos - center));
+    }
+    boundingSphere = glm::vec4(center, radius);
 }
 
 Mesh::~Mesh(){}
 
 void Mesh::destroyBuffers(){
-    vkDestroyBuffer(device, indexBuffer, nullptr);
-    vkFreeMemory(device, indexBufferMemory, nullptr);
-    vkDestroyBuffer(device, vertexBuffer, nullptr);
-    vkFreeMemory(device, vertexBufferMemory, nullptr);
+    vkDestroyBuffer(device, indexBuffer, getHostCallbacks());
+    vkFreeMemory(device, indexBufferMemory, getHostCallbacks());
+    vkDestroyBuffer(device, vertexBuffer, getHostCallbacks());
+    vkFreeMemory(device, vertexBufferMemory, getHostCallbacks());
+    vkDestroyBuffer(device, positionBuffer, getHostCallbacks());
+    vkFreeMemory(device, positionBufferMemory, getHostCallbacks());
+}
+
+void Mesh::retireBuffers(DeletionQueue &deletionQueue, uint64_t value){
+    deletionQueue.destroyBuffer(indexBuffer, value);
+    deletionQueue.freeMemory(indexBufferMemory, value);
+    deletionQueue.destroyBuffer(vertexBuffer, value);
+    deletionQueue.freeMemory(vertexBufferMemory, value);
+    deletionQueue.destroyBuffer(positionBuffer, value);
+    deletionQueue.freeMemory(positionBufferMemory, value);
 }
 
 
@@ -34,6 +60,10 @@ int Mesh::getTexId(){
     return texId;
 }
 
+glm::vec4 Mesh::getBoundingSphere(){
+    return boundingSphere;
+}
+
 size_t Mesh::getIndexCount(){
     return indexCount;
 }
@@ -46,91 +76,64 @@ VkBuffer Mesh::getVertexBuffer(){
     return vertexBuffer;
 }
 
+VkBuffer Mesh::getPositionBuffer(){
+    return positionBuffer;
+}
+
 VkBuffer Mesh::getIndexBuffer(){
     return indexBuffer;
 }
 
-void Mesh::createIndexBuffer(VkQueue transferQueue,
-                             VkCommandPool transferCommandPool,
+void Mesh::createIndexBuffer(Uploader &uploader,
                              const QueueFamilyIndices &queueFamilyIndices,
                              const std::vector<uint32_t> & indices){
     VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    QueueFamilyIndices ids1 = { {}, {}, queueFamilyIndices.transferFamily };
-    createBuffer(device,
-                 physicalDevice,
-                 ids1,
-                 bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
-    
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
-    
-    QueueFamilyIndices ids2 = { queueFamilyIndices.graphicsFamily, {}, queueFamilyIndices.transferFamily };
+    // exclusive to graphics, the uploader hands ownership over after the copy
+    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {} };
     createBuffer(device,
                  physicalDevice,
-                 ids2,
+                 ids,
                  bufferSize,
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
     
-    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, transferCommandPool);
-    copyBuffer(commandBuffer, stagingBuffer, indexBuffer, bufferSize);
-    flushSetupCommands(device, commandBuffer, transferCommandPool, transferQueue);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    uploader.uploadBuffer(indexBuffer, indices.data(), bufferSize);
 }
 
-void Mesh::createVertexBuffer(VkQueue transferQueue,
-                              VkCommandPool transferCommandPool,
+void Mesh::createVertexBuffer(Uploader &uploader,
                               const QueueFamilyIndices &queueFamilyIndices,
                               const std::vector<Vertex> &vertices){
     VkDeviceSize bufferSize = sizeof(Vertex) * vertices.size();
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    QueueFamilyIndices ids1 = { {}, {}, queueFamilyIndices.transferFamily };
+    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {} };
     createBuffer(device,
                  physicalDevice,
-                 ids1,
+                 ids,
                  bufferSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
     
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    uploader.uploadBuffer(vertexBuffer, vertices.data(), bufferSize);
+}
+
+void Mesh::createPositionBuffer(Uploader &uploader,
+                                const QueueFamilyIndices &queueFamilyIndices,
+                                const std::vector<Vertex> &vertices){
+    // a third of the interleaved vertex size, the depth pre-pass fetches nothing it does not use
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        positions[i] = vertices[i].pos;
+    }
+    VkDeviceSize bufferSize = sizeof(glm::vec3) * positions.size();
     
-    QueueFamilyIndices ids2 = { queueFamilyIndices.graphicsFamily, {}, queueFamilyIndices.transferFamily };
+    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {} };
     createBuffer(device,
                  physicalDevice,
-                 ids2,
+                 ids,
                  bufferSize,
                  VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, positionBuffer, positionBufferMemory);
     
-    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, transferCommandPool);
-    copyBuffer(commandBuffer, stagingBuffer, vertexBuffer, bufferSize);
-    flushSetupCommands(device, commandBuffer, transferCommandPool, transferQueue);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-}
-
-
-void Mesh::setModel(glm::mat4 newModel){
-    model = newModel;
-}
-
-glm::mat4 Mesh::getModel(){
-    return model;
+    uploader.uploadBuffer(positionBuffer, positions.data(), bufferSize);
 }
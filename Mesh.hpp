@@ -11,40 +11,45 @@
 #pragma clang diagnostic pop
 
 #include "Utilities.h"
+#include "Uploader.hpp"
+#include "DeletionQueue.hpp"
 
 class Mesh{
 public:
     Mesh();
     Mesh(VkPhysicalDevice physicalDevice,
          VkDevice device,
-         VkQueue transferQueue,
-         VkCommandPool transferCommandPool,
+         Uploader &uploader,
          const QueueFamilyIndices &indices,
          const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indicies, int newTexId);
     
-    void setModel(glm::mat4 newModel);
-    glm::mat4 getModel();
-    
     int getTexId();
+    glm::vec4 getBoundingSphere();
     
     size_t getVertexCount();
     size_t getIndexCount();
 
     VkBuffer getVertexBuffer();
+    VkBuffer getPositionBuffer();
     VkBuffer getIndexBuffer();
 
     void destroyBuffers();
+    // queues the buffers for destruction once the graphics timeline reaches value
+    void retireBuffers(DeletionQueue &deletionQueue, uint64_t value);
     
     ~Mesh();
 private:
-    glm::mat4 model;
-    
     int texId;
+    glm::vec4 boundingSphere;       // local space center (xyz) and radius (w), used by GPU culling
     
     size_t vertexCount;
     VkBuffer vertexBuffer;
     VkDeviceMemory vertexBufferMemory;
     
+    // positions only, read by the depth pre-pass
+    VkBuffer positionBuffer;
+    VkDeviceMemory positionBufferMemory;
+    
     size_t indexCount;
     VkBuffer indexBuffer;
     VkDeviceMemory indexBufferMemory;
@@ -52,12 +57,13 @@ private:
     VkPhysicalDevice physicalDevice;
     VkDevice device;
     
-    void createVertexBuffer(VkQueue transferQueue,
-                            VkCommandPool transferCommandPool,
+    void createVertexBuffer(Uploader &uploader,
                             const QueueFamilyIndices &queueFamilyIndices,
                             const std::vector<Vertex> &vertices);
-    void createIndexBuffer(VkQueue transferQueue,
-                           VkCommandPool transferCommandPool,
+    void createPositionBuffer(Uploader &uploader,
+                              const QueueFamilyIndices &queueFamilyIndices,
+                              const std::vector<Vertex> &vertices);
+    void createIndexBuffer(Uploader &uploader,
                            const QueueFamilyIndices &queueFamilyIndices,
                            const std::vector<uint32_t> &indices);
 };
@@ -1,13 +1,35 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "MeshModel.hpp"
 
-MeshModel::MeshModel(std::vector<Mesh> newMeshList){
-    model = glm::mat4(1.0f);
+MeshModel::MeshModel(){}
+
+MeshModel::MeshModel(std::vector<Mesh> newMeshList, uint32_t newNodeId){
+    nodeId = newNodeId;
     meshList = newMeshList;
 }
 
 MeshModel::~MeshModel(){}
 
+void MeshModel::setMeshes(const std::vector<Mesh> &newMeshList){
+    meshList = newMeshList;
+}
+
+AssetState MeshModel::getState(){
+    return state;
+}
+
+void MeshModel::setState(AssetState newState){
+    state = newState;
+}
+
+uint64_t MeshModel::getStreamRequest(){
+    return streamRequest;
+}
+
+void MeshModel::setStreamRequest(uint64_t request){
+    streamRequest = request;
+}
+
 size_t MeshModel::getMeshCount(){
     return meshList.size();
 }
@@ -19,80 +41,129 @@ Mesh* MeshModel::getMesh(size_t index){
     return &meshList[index];
 }
 
-glm::mat4 MeshModel::getModel(){
-    return model;
-}
-
-void MeshModel::setModel(glm::mat4 newModel){
-    model = newModel;
+uint32_t MeshModel::getNodeId(){
+    return nodeId;
 }
 
-void MeshModel::destroyMeshModel(){
-    for(auto &mesh: meshList){
-        mesh.destroyBuffers();
-    }
+uint64_t MeshModel::getAsset(){
+    return asset;
 }
 
-std::vector<std::string> MeshModel::LoadMaterials(){
-    return { TEXTURE_PATH };
+void MeshModel::setAsset(uint64_t key){
+    asset = key;
 }
 
-Mesh MeshModel::LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
-                         VkQueue transferQueue, VkCommandPool transferCommandPool,
-                         const QueueFamilyIndices &queueFamilyIndices,
-                         const std::vector<int> &matToTex){
-    
+bool MeshModel::LoadSubMeshes(std::istream &objStream, std::istream &mtlStream, std::vector<SubMesh> &subMeshes, std::string &error,
+                              JobSystem &jobSystem){
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
     std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-        throw std::runtime_error(warn + err);
-    }
     
-    std::vector<Vertex> vertices;
-    std::vector<uint32_t> indices;
+    // every mtllib statement reads the same stream, the streamer concatenates the material libraries
+    tinyobj::MaterialStreamReader materialReader(mtlStream);
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &objStream, &materialReader)) {
+        error = warn + err;
+        return false;
+    }
     
-    std::unordered_map<Vertex, uint32_t> vertexToIndex;
+    // one sub-mesh per material, in order of first use. Faces are triangulated on load.
+    std::unordered_map<int, size_t> materialToSubMesh;
+    std::vector<std::vector<const tinyobj::index_t*>> subMeshCorners;
     
     for (const auto& shape : shapes) {
-        for (const auto& index : shape.mesh.indices) {
-            Vertex vertex{};
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index + 0],
-                1 - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-            vertex.color = {1.0f, 1.0f, 1.0f};
+        for (size_t i = 0; i < shape.mesh.indices.size(); ++i) {
+            int material = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[i / 3];
+            if (material >= static_cast<int>(materials.size())) {
+                material = -1;
+            }
             
-            if(vertexToIndex.find(vertex) == vertexToIndex.end()){
-                vertexToIndex[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
+            auto found = materialToSubMesh.find(material);
+            if (found == materialToSubMesh.end()) {
+                found = materialToSubMesh.emplace(material, subMeshes.size()).first;
+                subMeshes.push_back(SubMesh());
+                subMeshes.back().material = material;
+                subMeshCorners.emplace_back();
             }
-            indices.push_back(vertexToIndex[vertex]);
+            subMeshCorners[found->second].push_back(&shape.mesh.indices[i]);
         }
     }
     
-    return Mesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, queueFamilyIndices, vertices, indices, matToTex[0]);
-}
-
-std::vector<Mesh> MeshModel::LoadMeshes(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
-                                       VkQueue transferQueue, VkCommandPool transferCommandPool,
-                                       const QueueFamilyIndices & queueFamilyIndices,
-                                       const std::vector<int> &matToTex){
-    return { LoadMesh(newPhysicalDevice, newDevice, transferQueue, transferCommandPool, queueFamilyIndices, matToTex) };
-}
-
-void MeshModel::updateModel(){
-    static auto startTime = std::chrono::high_resolution_clock::now();
+    if (subMeshes.empty()) {
+        error = "model has no faces.";
+        return false;
+    }
     
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();       // in seconds
-        
-    model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));;
+    // corners are deduplicated in fixed size chunks in parallel, then the chunks' unique vertices are merged
+    // in order. Vertices keep the order of their first use, as a serial pass would give them.
+    struct Chunk {
+        size_t subMesh;
+        size_t begin;
+        size_t end;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;          // into vertices
+    };
+    const size_t chunkSize = 16384;
+    std::vector<Chunk> chunks;
+    std::vector<size_t> firstChunk;
+    for (size_t i = 0; i < subMeshCorners.size(); ++i) {
+        firstChunk.push_back(chunks.size());
+        for (size_t begin = 0; begin < subMeshCorners[i].size(); begin += chunkSize) {
+            chunks.push_back({ i, begin, std::min(begin + chunkSize, subMeshCorners[i].size()), {}, {} });
+        }
+    }
+    firstChunk.push_back(chunks.size());
+    
+    jobSystem.parallelFor(static_cast<uint32_t>(chunks.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t c = begin; c < end; ++c) {
+            Chunk &chunk = chunks[c];
+            std::unordered_map<Vertex, uint32_t> chunkIndices;
+            for (size_t i = chunk.begin; i < chunk.end; ++i) {
+                const tinyobj::index_t &index = *subMeshCorners[chunk.subMesh][i];
+                Vertex vertex{};
+                vertex.pos = {
+                    attrib.vertices[3 * index.vertex_index + 0],
+                    attrib.vertices[3 * index.vertex_index + 1],
+                    attrib.vertices[3 * index.vertex_index + 2]
+                };
+                if (index.texcoord_index >= 0) {
+                    vertex.texCoord = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        1 - attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                }
+                vertex.color = {1.0f, 1.0f, 1.0f};
+                
+                auto inserted = chunkIndices.emplace(vertex, static_cast<uint32_t>(chunk.vertices.size()));
+                if (inserted.second) {
+                    chunk.vertices.push_back(vertex);
+                }
+                chunk.indices.push_back(inserted.first->second);
+            }
+        }
+    });
+    
+    jobSystem.parallelFor(static_cast<uint32_t>(subMeshes.size()), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            SubMesh &subMesh = subMeshes[i];
+            std::unordered_map<Vertex, uint32_t> subMeshIndices;
+            std::vector<uint32_t> remap;
+            subMesh.indices.reserve(subMeshCorners[i].size());
+            for (size_t c = firstChunk[i]; c < firstChunk[i + 1]; ++c) {
+                Chunk &chunk = chunks[c];
+                remap.resize(chunk.vertices.size());
+                for (size_t v = 0; v < chunk.vertices.size(); ++v) {
+                    auto inserted = subMeshIndices.emplace(chunk.vertices[v], static_cast<uint32_t>(subMesh.vertices.size()));
+                    if (inserted.second) {
+                        subMesh.vertices.push_back(chunk.vertices[v]);
+                    }
+                    remap[v] = inserted.first->second;
+                }
+                for (uint32_t index : chunk.indices) {
+                    subMesh.indices.push_back(remap[index]);
+                }
+            }
+        }
+    });
+    return true;
 }
@@ -8,40 +8,62 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <unordered_map>
+#include <istream>
 
 #include "tiny_obj_loader.h"
 
 #include "Mesh.hpp"
+#include "JobSystem.hpp"
 
+// faces of one material, before upload
+struct SubMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    int material = -1;                      // index into the OBJ's materials, -1 without one
+};
+
+// GPU data loaded from one model file, shared by every MeshModel created from the same contents.
+// Holds a reference on each of its textures.
+struct ModelAsset {
+    std::vector<Mesh> meshes;
+    std::vector<uint64_t> textures;         // texture cache keys
+};
+
+// An instance of a ModelAsset in the scene graph. The meshes are copies of the shared handles, the
+// renderer's model cache owns the buffers.
 class MeshModel {
 public:
     MeshModel();
-    MeshModel(std::vector<Mesh> newMeshList);
+    MeshModel(std::vector<Mesh> newMeshList, uint32_t newNodeId);
+    
+    // streamed models start out empty in the Loading state
+    void setMeshes(const std::vector<Mesh> &newMeshList);
+    AssetState getState();
+    void setState(AssetState newState);
+    uint64_t getStreamRequest();
+    void setStreamRequest(uint64_t request);
     
     size_t getMeshCount();
     Mesh* getMesh(size_t index);
     
-    glm::mat4 getModel();
-    void setModel(glm::mat4 newModel);
-    
-    void destroyMeshModel();
+    uint32_t getNodeId();
     
-    void updateModel();
+    // key of the shared ModelAsset the meshes belong to, 0 while there is none
+    uint64_t getAsset();
+    void setAsset(uint64_t key);
     
-    static std::vector<std::string> LoadMaterials();
-    static Mesh LoadMesh(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
-                         VkQueue transferQueue, VkCommandPool transferCommandPool,
-                         const QueueFamilyIndices & queueFamilyIndices,
-                         const std::vector<int> &matToTex);
-    static std::vector<Mesh> LoadMeshes(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice,
-                                        VkQueue transferQueue, VkCommandPool transferCommandPool,
-                                        const QueueFamilyIndices & queueFamilyIndices,
-                                        const std::vector<int> &matToTex);
+    // parses OBJ text into one deduplicated sub-mesh per material. mtlStream holds the material libraries
+    // the OBJ refers to. CPU only, safe on any thread, vertices are built and deduplicated on jobSystem.
+    static bool LoadSubMeshes(std::istream &objStream, std::istream &mtlStream, std::vector<SubMesh> &subMeshes, std::string &error,
+                              JobSystem &jobSystem);
     ~MeshModel();
     
 private:
     std::vector<Mesh> meshList;
-    glm::mat4 model;
+    uint32_t nodeId;                // transform node in the renderer's scene graph
+    uint64_t asset = 0;
+    AssetState state = AssetState::Ready;
+    uint64_t streamRequest = 0;     // AssetStreamer request while Loading
 };
 
 #endif /* Model_hpp */
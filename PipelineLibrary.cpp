@@ -0,0 +1,395 @@
+#include "PipelineLibrary.hpp"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+
+#include "AssetCache.hpp"
+
+uint64_t PipelineDesc::hash() const{
+    uint64_t hash = hashContent(vertexShader.data(), vertexShader.size());
+    hash = hashCombine(hash, hashContent(fragmentShader.data(), fragmentShader.size()));
+    hash = hashCombine(hash, hashContent(specialization.data(), specialization.size() * sizeof(uint32_t)));
+
+    std::array<uint32_t, 10> state = {
+        positionsOnly, static_cast<uint32_t>(depthCompareOp), depthWrite, colorWrite, blend, sampleShading,
+        dynamicDepthState, static_cast<uint32_t>(samples), static_cast<uint32_t>(colorFormat),
+        static_cast<uint32_t>(depthFormat)
+    };
+    hash = hashCombine(hash, hashContent(state.data(), sizeof(state)));
+    hash = hashCombine(hash, hashContent(&renderPass, sizeof(renderPass)));
+    hash = hashCombine(hash, hashContent(&layout, sizeof(layout)));
+    return hash;
+}
+
+PipelineLibrary::PipelineLibrary(){}
+
+void PipelineLibrary::start(VkDevice newDevice, uint32_t workerCount, const std::string &newCacheFile){
+    device = newDevice;
+    cacheFile = newCacheFile;
+
+    // the driver checks the header and ignores data from another device or driver version
+    std::vector<char> cacheData;
+    std::ifstream file(cacheFile, std::ios::ate | std::ios::binary);
+    if (file.is_open()) {
+        cacheData.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(cacheData.data(), cacheData.size());
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    if (vkCreatePipelineCache(device, &cacheInfo, getHostCallbacks(), &pipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache.");
+    }
+
+    workerCount = std::max(workerCount, 1u);
+    for (uint32_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(&PipelineLibrary::workerLoop, this);
+    }
+}
+
+void PipelineLibrary::destroy(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        jobs.clear();
+    }
+    workerCondition.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    moveFinished();
+    for (auto &pipeline : pipelines) {
+        if (pipeline.second != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline.second, getHostCallbacks());
+        }
+    }
+    pipelines.clear();
+    requested.clear();
+
+    for (auto &shaderModule : shaderModules) {
+        vkDestroyShaderModule(device, shaderModule.second, getHostCallbacks());
+    }
+    shaderModules.clear();
+
+    saveCache();
+    vkDestroyPipelineCache(device, pipelineCache, getHostCallbacks());
+}
+
+VkPipeline PipelineLibrary::build(const PipelineDesc &desc){
+    uint64_t key = desc.hash();
+    auto found = pipelines.find(key);
+    if (found != pipelines.end() && found->second != VK_NULL_HANDLE) {
+        return found->second;
+    }
+
+    VkPipeline pipeline = compile(desc);
+    pipelines[key] = pipeline;
+    return pipeline;
+}
+
+VkPipeline PipelineLibrary::request(const PipelineDesc &desc){
+    uint64_t key = desc.hash();
+    auto found = pipelines.find(key);
+    if (found != pipelines.end()) {
+        return found->second;
+    }
+    if (!requested.insert(key).second) {
+        return VK_NULL_HANDLE;                          // already queued or compiling
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back({ key, desc });
+    }
+    workerCondition.notify_one();
+    return VK_NULL_HANDLE;
+}
+
+size_t PipelineLibrary::collect(){
+    return moveFinished();
+}
+
+void PipelineLibrary::retireAll(DeletionQueue &deletionQueue, uint64_t value){
+    {
+        // results of running compiles would refer to the old render pass, wait for them rather than track them
+        std::unique_lock<std::mutex> lock(mutex);
+        jobs.clear();
+        idleCondition.wait(lock, [this] { return compiling == 0; });
+    }
+
+    moveFinished();
+    for (auto &pipeline : pipelines) {
+        if (pipeline.second != VK_NULL_HANDLE) {
+            deletionQueue.destroyPipeline(pipeline.second, value);
+        }
+    }
+    pipelines.clear();
+    requested.clear();
+}
+
+size_t PipelineLibrary::getPipelineCount(){
+    return pipelines.size();
+}
+
+size_t PipelineLibrary::getPendingCount(){
+    return requested.size();
+}
+
+void PipelineLibrary::workerLoop(){
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workerCondition.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            compiling++;
+        }
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        try {
+            pipeline = compile(job.desc);
+        } catch (std::exception &err) {
+            std::cerr << "failed to compile pipeline variant: " << err.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.push_back({ job.key, pipeline });
+            compiling--;
+        }
+        idleCondition.notify_all();
+    }
+}
+
+size_t PipelineLibrary::moveFinished(){
+    std::vector<std::pair<uint64_t, VkPipeline>> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.swap(finished);
+    }
+
+    size_t ready = 0;
+    for (auto &result : results) {
+        requested.erase(result.first);
+        auto found = pipelines.find(result.first);
+        if (found != pipelines.end() && found->second != VK_NULL_HANDLE) {
+            // built on the render thread meanwhile, the duplicate was never used
+            if (result.second != VK_NULL_HANDLE) {
+                vkDestroyPipeline(device, result.second, getHostCallbacks());
+            }
+            continue;
+        }
+        pipelines[result.first] = result.second;
+        if (result.second != VK_NULL_HANDLE) {
+            ready++;
+        }
+    }
+    return ready;
+}
+
+VkPipeline PipelineLibrary::compile(const PipelineDesc &desc){
+    // specialization constants are resolved by the driver, branches on them are compiled out
+    std::vector<VkSpecializationMapEntry> specializationEntries(desc.specialization.size());
+    for (uint32_t i = 0; i < specializationEntries.size(); i++) {
+        specializationEntries[i].constantID = i;
+        specializationEntries[i].offset = i * sizeof(uint32_t);
+        specializationEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+    specializationInfo.pMapEntries = specializationEntries.data();
+    specializationInfo.dataSize = desc.specialization.size() * sizeof(uint32_t);
+    specializationInfo.pData = desc.specialization.data();
+
+    std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = getShaderModule(desc.vertexShader);
+    vertShaderStageInfo.pName = "main";
+    shaderStages.push_back(vertShaderStageInfo);
+
+    if (!desc.fragmentShader.empty()) {
+        VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragShaderStageInfo.module = getShaderModule(desc.fragmentShader);
+        fragShaderStageInfo.pName = "main";
+        fragShaderStageInfo.pSpecializationInfo = desc.specialization.empty() ? nullptr : &specializationInfo;
+        shaderStages.push_back(fragShaderStageInfo);
+    }
+
+    // vertex input bindings info and vertex binding attributes
+    auto bindingDescription = Vertex::getBindingDescription();
+    auto attributeDescriptions = Vertex::getAttributeDescriptions();
+    auto positionBindingDescription = Vertex::getPositionBindingDescription();
+    auto positionAttributeDescription = Vertex::getPositionAttributeDescription();
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    if (desc.positionsOnly) {
+        vertexInputInfo.pVertexBindingDescriptions = &positionBindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = 1;
+        vertexInputInfo.pVertexAttributeDescriptions = &positionAttributeDescription;
+    } else {
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    }
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;       // draw triangles with 3 vertices at a time
+    inputAssembly.primitiveRestartEnable = VK_FALSE;                    // for strip topology only
+
+    // viewport and scissor are set while recording, the render resolution changes without a new pipeline
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = nullptr;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = nullptr;
+
+    std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    if (desc.dynamicDepthState) {
+        dynamicStates.insert(dynamicStates.end(), {
+            VK_DYNAMIC_STATE_CULL_MODE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+            VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT
+        });
+    }
+
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    // rasterizer stage does depth testing, scissor tests and face culling
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;                     // discard fragments beyond [near, far] plane
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = desc.sampleShading ? VK_TRUE : VK_FALSE;
+    multisampling.minSampleShading = 0.2f;
+    multisampling.rasterizationSamples = desc.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = desc.depthWrite ? VK_TRUE : VK_FALSE;
+    depthStencil.depthCompareOp = desc.depthCompareOp;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    // alpha blending for the framebuffer
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = desc.colorWrite ? VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT : 0;
+    colorBlendAttachment.blendEnable = desc.blend ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+    pipelineInfo.pStages = shaderStages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = desc.layout;
+    pipelineInfo.renderPass = desc.renderPass;
+    pipelineInfo.subpass = 0;
+    
+    // dynamic rendering: no render pass, the attachment formats stand in for it
+    VkPipelineRenderingCreateInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+    renderingInfo.depthAttachmentFormat = desc.depthFormat;
+    if (desc.renderPass == VK_NULL_HANDLE) {
+        pipelineInfo.pNext = &renderingInfo;
+    }
+
+    // the cache is internally synchronized, workers share it
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, getHostCallbacks(), &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+VkShaderModule PipelineLibrary::getShaderModule(const std::string &file){
+    std::lock_guard<std::mutex> lock(moduleMutex);
+    auto found = shaderModules.find(file);
+    if (found != shaderModules.end()) {
+        return found->second;
+    }
+
+    std::vector<char> code = readFile(file);
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, getHostCallbacks(), &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    shaderModules[file] = shaderModule;
+    return shaderModule;
+}
+
+void PipelineLibrary::saveCache(){
+    if (cacheFile.empty()) {
+        return;
+    }
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    std::ofstream file(cacheFile, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), size);
+}
@@ -0,0 +1,113 @@
+#ifndef PipelineLibrary_hpp
+#define PipelineLibrary_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Utilities.h"
+#include "DeletionQueue.hpp"
+
+// everything a graphics pipeline is built from. Viewport and scissor are dynamic and not part of it.
+struct PipelineDesc {
+    std::string vertexShader;                   // SPIR-V files
+    std::string fragmentShader;                 // empty for depth only pipelines
+    std::vector<uint32_t> specialization;       // fragment shader constants, constant_id is the index
+    bool positionsOnly = false;                 // position stream instead of the full vertex
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+    bool depthWrite = true;
+    bool colorWrite = true;
+    bool blend = true;
+    bool sampleShading = true;
+    bool dynamicDepthState = false;             // cull mode and depth test, write and compare op set while recording
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkRenderPass renderPass = VK_NULL_HANDLE;   // VK_NULL_HANDLE for dynamic rendering, built against the formats
+    VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+
+    uint64_t hash() const;
+};
+
+// Graphics pipelines keyed by a hash of their full state. Variants are compiled by worker threads through a
+// shared VkPipelineCache, which is loaded from and saved to disk, so a new variant never stalls the render
+// thread: request() returns VK_NULL_HANDLE until it is ready and the caller draws with a fallback meanwhile.
+// The library owns every pipeline it hands out.
+class PipelineLibrary{
+public:
+    PipelineLibrary();
+
+    // the library owns threads and locks, it is started in place rather than assigned
+    void start(VkDevice device, uint32_t workerCount, const std::string &cacheFile);
+    // device idle, saves the pipeline cache
+    void destroy();
+
+    // compiles on the calling thread, for fallbacks that have to exist before the first frame
+    VkPipeline build(const PipelineDesc &desc);
+    // the pipeline when ready, otherwise VK_NULL_HANDLE and the first call queues a compile.
+    // A variant that failed to compile stays VK_NULL_HANDLE.
+    VkPipeline request(const PipelineDesc &desc);
+    // makes finished compiles visible to request(), returns how many became usable. Once per frame.
+    size_t collect();
+
+    // render pass change: drops queued compiles, waits for running ones and queues every pipeline for
+    // destruction at value
+    void retireAll(DeletionQueue &deletionQueue, uint64_t value);
+
+    size_t getPipelineCount();
+    // queued or compiling
+    size_t getPendingCount();
+
+private:
+    struct Job {
+        uint64_t key;
+        PipelineDesc desc;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    std::string cacheFile;
+
+    // render thread only
+    std::unordered_map<uint64_t, VkPipeline> pipelines;
+    std::unordered_set<uint64_t> requested;
+
+    // shared with the workers
+    std::mutex mutex;
+    std::condition_variable workerCondition;    // new jobs
+    std::condition_variable idleCondition;      // a compile finished
+    bool stopping = false;
+    std::deque<Job> jobs;
+    size_t compiling = 0;
+    std::vector<std::pair<uint64_t, VkPipeline>> finished;
+
+    // loaded on first use by any thread
+    std::mutex moduleMutex;
+    std::unordered_map<std::string, VkShaderModule> shaderModules;
+
+    std::vector<std::thread> workers;
+
+    void workerLoop();
+    size_t moveFinished();
+    VkPipeline compile(const PipelineDesc &desc);
+    VkShaderModule getShaderModule(const std::string &file);
+    void saveCache();
+};
+
+#endif /* PipelineLibrary_hpp */
@@ -0,0 +1,67 @@
+#ifndef RadixSort_hpp
+#define RadixSort_hpp
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LSD radix sort of 64-bit keys carrying a 32-bit value, one byte per pass. All eight histograms come from
+// a single read of the keys, and passes whose byte is the same for every key are skipped, so keys whose
+// high bits rarely differ cost only the passes that actually vary. Stable, the scratch vectors are reused
+// between calls to avoid allocating.
+static inline void radixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values,
+                             std::vector<uint64_t> &keyScratch, std::vector<uint32_t> &valueScratch) {
+    size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+    keyScratch.resize(count);
+    valueScratch.resize(count);
+    
+    uint32_t histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = keys[i];
+        for (int pass = 0; pass < 8; pass++) {
+            histograms[pass][(key >> (pass * 8)) & 0xff]++;
+        }
+    }
+    
+    uint64_t *srcKeys = keys.data();
+    uint32_t *srcValues = values.data();
+    uint64_t *dstKeys = keyScratch.data();
+    uint32_t *dstValues = valueScratch.data();
+    
+    for (int pass = 0; pass < 8; pass++) {
+        uint32_t *histogram = histograms[pass];
+        uint32_t shift = pass * 8;
+        if (histogram[(srcKeys[0] >> shift) & 0xff] == count) {
+            continue;                                   // every key has this byte
+        }
+        
+        uint32_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint32_t slot = histogram[(srcKeys[i] >> shift) & 0xff]++;
+            dstKeys[slot] = srcKeys[i];
+            dstValues[slot] = srcValues[i];
+        }
+        
+        std::swap(srcKeys, dstKeys);
+        std::swap(srcValues, dstValues);
+    }
+    
+    // an odd number of passes leaves the result in the scratch vectors
+    if (srcKeys != keys.data()) {
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+#endif /* RadixSort_hpp */
@@ -0,0 +1,653 @@
+#include "RenderGraph.hpp"
+#include "Utilities.h"
+
+#include <algorithm>
+
+// access bits that make a later access a hazard
+static const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT |
+                                               VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                               VK_ACCESS_TRANSFER_WRITE_BIT |
+                                               VK_ACCESS_HOST_WRITE_BIT |
+                                               VK_ACCESS_MEMORY_WRITE_BIT;
+
+RenderGraph::RenderGraph(){}
+
+void RenderGraph::reset(){
+    resources.clear();
+    passes.clear();
+    aliasSlots.clear();
+    compiledPasses.clear();
+    finalBarriers.clear();
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string &name, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStage){
+    ResourceNode node = {};
+    node.name = name;
+    node.isImage = true;
+    node.transient = false;
+    node.info.aspect = aspect;
+    node.initialLayout = initialLayout;
+    node.initialStage = initialStage;
+    node.initialAccess = 0;
+    resources.push_back(node);
+
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string &name, VkPipelineStageFlags initialStage, VkAccessFlags initialAccess){
+    ResourceNode node = {};
+    node.name = name;
+    node.isImage = false;
+    node.transient = false;
+    node.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    node.initialStage = initialStage;
+    node.initialAccess = initialAccess;
+    resources.push_back(node);
+
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createTransientImage(const std::string &name, const ImageInfo &info){
+    ResourceNode node = {};
+    node.name = name;
+    node.isImage = true;
+    node.transient = true;
+    node.info = info;
+    node.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    node.initialStage = 0;
+    node.initialAccess = 0;
+    resources.push_back(node);
+
+    return static_cast<Resource>(resources.size() - 1);
+}
+
+RenderGraph::Pass RenderGraph::addPass(const std::string &name){
+    PassNode node;
+    node.name = name;
+    passes.push_back(node);
+
+    return static_cast<Pass>(passes.size() - 1);
+}
+
+void RenderGraph::read(Pass pass, Resource resource, ResourceUsage usage){
+    addAccess(pass, resource, usage, false);
+}
+
+void RenderGraph::write(Pass pass, Resource resource, ResourceUsage usage){
+    addAccess(pass, resource, usage, true);
+}
+
+void RenderGraph::markOutput(Resource resource, ResourceUsage finalUsage){
+    if (resource >= resources.size()) {
+        throw std::runtime_error("render graph: unknown output resource.");
+    }
+
+    resources[resource].output = true;
+    resources[resource].finalAccess = getUsageAccess(resource, finalUsage, false);
+}
+
+RenderGraph::Access RenderGraph::getUsageAccess(Resource resource, ResourceUsage usage, bool write){
+    Access access = {};
+    access.resource = resource;
+    access.read = !write;
+    access.write = write;
+
+    switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            access.stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            access.access = write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            break;
+        case ResourceUsage::DepthAttachment:
+            // the depth test reads even when the pass only writes
+            access.stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+            access.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+            access.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            break;
+        case ResourceUsage::Sampled:
+            access.stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            access.access = VK_ACCESS_SHADER_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            break;
+        case ResourceUsage::StorageRead:
+            access.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            access.access = VK_ACCESS_SHADER_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_GENERAL;
+            break;
+        case ResourceUsage::StorageWrite:
+            access.stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+            access.access = VK_ACCESS_SHADER_WRITE_BIT;
+            access.layout = VK_IMAGE_LAYOUT_GENERAL;
+            break;
+        case ResourceUsage::TransferSrc:
+            access.stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            access.access = VK_ACCESS_TRANSFER_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            break;
+        case ResourceUsage::TransferDst:
+            access.stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+            access.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+            access.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            break;
+        case ResourceUsage::IndirectRead:
+            access.stage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+            access.access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            break;
+        case ResourceUsage::VertexRead:
+            access.stage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            access.access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+            access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            break;
+        case ResourceUsage::Present:
+            // the presentation engine waits on a semaphore, no access to make visible
+            access.stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            access.access = 0;
+            access.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            break;
+    }
+
+    if (!resources[resource].isImage) {
+        access.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+
+    return access;
+}
+
+void RenderGraph::addAccess(Pass pass, Resource resource, ResourceUsage usage, bool write){
+    if (pass >= passes.size() || resource >= resources.size()) {
+        throw std::runtime_error("render graph: unknown pass or resource.");
+    }
+
+    Access access = getUsageAccess(resource, usage, write);
+
+    // one entry per resource and pass, e.g. a load-op attachment is both read and written
+    for (auto &existing : passes[pass].accesses) {
+        if (existing.resource != resource) {
+            continue;
+        }
+        if (existing.layout != access.layout) {
+            throw std::runtime_error("render graph: pass " + passes[pass].name + " uses " + resources[resource].name + " in two layouts.");
+        }
+        existing.stage |= access.stage;
+        existing.access |= access.access;
+        existing.read = existing.read || access.read;
+        existing.write = existing.write || access.write;
+        return;
+    }
+
+    passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::compile(){
+    compiledPasses.clear();
+    finalBarriers.clear();
+    aliasSlots.clear();
+
+    cullPasses();
+    assignAliasSlots();
+    compileBarriers();
+}
+
+void RenderGraph::cullPasses(){
+    // walk backwards from the outputs. A pass survives if it writes something still needed, a pass that
+    // overwrites a resource without reading it ends the need for earlier writers.
+    std::vector<bool> needed(resources.size(), false);
+    for (size_t i = 0; i < resources.size(); i++) {
+        needed[i] = resources[i].output;
+    }
+
+    for (size_t p = passes.size(); p-- > 0;) {
+        PassNode &pass = passes[p];
+
+        bool alive = false;
+        for (const auto &access : pass.accesses) {
+            if (access.write && needed[access.resource]) {
+                alive = true;
+            }
+        }
+
+        pass.culled = !alive;
+        if (!alive) {
+            continue;
+        }
+
+        for (const auto &access : pass.accesses) {
+            if (access.write && !access.read) {
+                needed[access.resource] = false;
+            }
+        }
+        for (const auto &access : pass.accesses) {
+            if (access.read) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::assignAliasSlots(){
+    std::vector<Resource> transients;
+    for (Resource r = 0; r < resources.size(); r++) {
+        ResourceNode &node = resources[r];
+        node.aliasSlot = UINT32_MAX;
+        node.firstUse = UINT32_MAX;
+        node.lastUse = 0;
+
+        if (node.transient) {
+            transients.push_back(r);
+        }
+    }
+
+    for (uint32_t p = 0; p < passes.size(); p++) {
+        if (passes[p].culled) {
+            continue;
+        }
+        for (const auto &access : passes[p].accesses) {
+            ResourceNode &node = resources[access.resource];
+            node.firstUse = std::min(node.firstUse, p);
+            node.lastUse = std::max(node.lastUse, p);
+        }
+    }
+
+    // outputs live until the end of the graph
+    for (auto &node : resources) {
+        if (node.output && node.firstUse != UINT32_MAX) {
+            node.lastUse = static_cast<uint32_t>(passes.size());
+        }
+    }
+
+    std::sort(transients.begin(), transients.end(), [this](Resource a, Resource b) {
+        return resources[a].firstUse < resources[b].firstUse;
+    });
+
+    // greedy interval packing, images of the same kind whose lifetimes do not overlap share a slot
+    for (Resource r : transients) {
+        ResourceNode &node = resources[r];
+        if (node.firstUse == UINT32_MAX) {
+            continue;                       // only used by culled passes, never allocated
+        }
+
+        for (uint32_t s = 0; s < aliasSlots.size(); s++) {
+            const ResourceNode &previous = resources[aliasSlots[s].resources.back()];
+            if (previous.lastUse < node.firstUse &&
+                previous.info.usage == node.info.usage &&
+                previous.info.samples == node.info.samples) {
+                node.aliasSlot = s;
+                break;
+            }
+        }
+
+        if (node.aliasSlot == UINT32_MAX) {
+            node.aliasSlot = static_cast<uint32_t>(aliasSlots.size());
+            aliasSlots.push_back(AliasSlot());
+        }
+        aliasSlots[node.aliasSlot].resources.push_back(r);
+    }
+}
+
+bool RenderGraph::trackAccess(ResourceState &state, const Access &access, Barrier &barrier){
+    bool isImage = resources[access.resource].isImage;
+    bool layoutChange = isImage && state.layout != access.layout;
+
+    bool hazard;
+    if (access.write) {
+        // write after write or write after read
+        hazard = state.writeStage != 0 || state.readStages != 0;
+    } else {
+        // read after write, skipped if an earlier barrier already covers this stage and access
+        hazard = state.writeStage != 0 &&
+                 ((state.visibleStages & access.stage) != access.stage ||
+                  (state.writeAccess != 0 && (state.visibleAccess & access.access) != access.access));
+    }
+
+    bool needed = layoutChange || hazard;
+    if (needed) {
+        barrier.resource = access.resource;
+        // a layout transition is a write, so it has to wait for readers as well
+        barrier.srcStage = state.writeStage | ((access.write || layoutChange) ? state.readStages : 0);
+        barrier.srcAccess = state.writeAccess;
+        barrier.dstStage = access.stage;
+        barrier.dstAccess = access.access;
+        barrier.oldLayout = isImage ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = isImage ? access.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (barrier.srcStage == 0) {
+            barrier.srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        }
+    }
+
+    if (access.write) {
+        state.writeStage = access.stage;
+        state.writeAccess = access.access & WRITE_ACCESS_MASK;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+    } else if (layoutChange) {
+        // later readers in other stages have to chain after the transition
+        state.writeStage = access.stage;
+        state.writeAccess = 0;
+        state.readStages = access.stage;
+        state.visibleStages = access.stage;
+        state.visibleAccess = access.access;
+    } else {
+        state.readStages |= access.stage;
+        if (needed) {
+            state.visibleStages |= access.stage;
+            state.visibleAccess |= access.access;
+        }
+    }
+    state.layout = access.layout;
+
+    return needed;
+}
+
+void RenderGraph::compileBarriers(){
+    // stage and access of each resource's last use, transients inherit it from the previous occupant of their
+    // memory (or, for the first occupant, from the last one in the previous frame)
+    std::vector<Access> lastAccesses(resources.size(), Access());
+    for (const auto &pass : passes) {
+        if (pass.culled) {
+            continue;
+        }
+        for (const auto &access : pass.accesses) {
+            lastAccesses[access.resource] = access;
+        }
+    }
+
+    std::vector<ResourceState> states(resources.size());
+    for (Resource r = 0; r < resources.size(); r++) {
+        const ResourceNode &node = resources[r];
+        ResourceState &state = states[r];
+
+        state.layout = node.initialLayout;
+        state.writeStage = node.initialStage;
+        state.writeAccess = node.initialAccess;
+        state.readStages = 0;
+        state.visibleStages = 0;
+        state.visibleAccess = 0;
+
+        if (node.transient && node.aliasSlot != UINT32_MAX) {
+            const std::vector<Resource> &occupants = aliasSlots[node.aliasSlot].resources;
+            size_t index = std::find(occupants.begin(), occupants.end(), r) - occupants.begin();
+            Resource previous = index == 0 ? occupants.back() : occupants[index - 1];
+
+            const Access &last = lastAccesses[previous];
+            state.writeStage = last.stage;
+            state.writeAccess = last.access & WRITE_ACCESS_MASK;
+            state.readStages = last.write ? 0 : last.stage;
+        }
+    }
+
+    for (Pass p = 0; p < passes.size(); p++) {
+        if (passes[p].culled) {
+            continue;
+        }
+
+        CompiledPass compiled;
+        compiled.pass = p;
+
+        for (const auto &access : passes[p].accesses) {
+            Barrier barrier;
+            if (trackAccess(states[access.resource], access, barrier)) {
+                compiled.barriers.push_back(barrier);
+            }
+        }
+
+        compiledPasses.push_back(compiled);
+    }
+
+    for (Resource r = 0; r < resources.size(); r++) {
+        if (!resources[r].output) {
+            continue;
+        }
+
+        Barrier barrier;
+        if (trackAccess(states[r], resources[r].finalAccess, barrier)) {
+            finalBarriers.push_back(barrier);
+        }
+    }
+}
+
+const std::vector<RenderGraph::CompiledPass>& RenderGraph::getCompiledPasses(){
+    return compiledPasses;
+}
+
+const std::vector<RenderGraph::Barrier>& RenderGraph::getFinalBarriers(){
+    return finalBarriers;
+}
+
+bool RenderGraph::isCulled(Pass pass){
+    return passes[pass].culled;
+}
+
+uint32_t RenderGraph::getAliasSlot(Resource resource){
+    return resources[resource].aliasSlot;
+}
+
+uint32_t RenderGraph::getAliasSlotCount(){
+    return static_cast<uint32_t>(aliasSlots.size());
+}
+
+const std::string& RenderGraph::getName(Resource resource){
+    return resources[resource].name;
+}
+
+void RenderGraph::allocateTransients(VkPhysicalDevice physicalDevice, VkDevice device, VkMemoryPropertyFlags memoryProperties){
+    for (auto &slot : aliasSlots) {
+        uint32_t memoryTypeBits = UINT32_MAX;
+        slot.size = 0;
+
+        for (Resource r : slot.resources) {
+            ResourceNode &node = resources[r];
+
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent.width = node.info.extent.width;
+            imageInfo.extent.height = node.info.extent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = node.info.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = node.info.usage;
+            imageInfo.samples = node.info.samples;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            if (vkCreateImage(device, &imageInfo, getHostCallbacks(), &node.image) != VK_SUCCESS) {
+                throw std::runtime_error("render graph: failed to create transient image " + node.name + ".");
+            }
+
+            VkMemoryRequirements memRequirements;
+            vkGetImageMemoryRequirements(device, node.image, &memRequirements);
+            memoryTypeBits &= memRequirements.memoryTypeBits;
+            slot.size = std::max(slot.size, memRequirements.size);
+        }
+
+        if (memoryTypeBits == 0) {
+            throw std::runtime_error("render graph: aliased images have no memory type in common.");
+        }
+
+        uint32_t memoryType;
+        try {
+            memoryType = findMemoryType(physicalDevice, memoryTypeBits, memoryProperties);
+            slot.lazy = (memoryProperties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+        } catch (std::runtime_error &) {
+            // most desktop GPUs have no lazily allocated memory
+            memoryType = findMemoryType(physicalDevice, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            slot.lazy = false;
+        }
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = slot.size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        if (vkAllocateMemory(device, &allocInfo, getHostCallbacks(), &slot.memory) != VK_SUCCESS) {
+            throw std::runtime_error("render graph: failed to allocate transient memory.");
+        }
+
+        // every occupant starts at offset 0, their lifetimes never overlap
+        for (Resource r : slot.resources) {
+            ResourceNode &node = resources[r];
+            vkBindImageMemory(device, node.image, slot.memory, 0);
+
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = node.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = node.info.format;
+            viewInfo.subresourceRange.aspectMask = node.info.aspect;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(device, &viewInfo, getHostCallbacks(), &node.imageView) != VK_SUCCESS) {
+                throw std::runtime_error("render graph: failed to create transient image view " + node.name + ".");
+            }
+        }
+    }
+}
+
+void RenderGraph::destroyTransients(VkDevice device){
+    for (auto &slot : aliasSlots) {
+        for (Resource r : slot.resources) {
+            ResourceNode &node = resources[r];
+            vkDestroyImageView(device, node.imageView, getHostCallbacks());
+            vkDestroyImage(device, node.image, getHostCallbacks());
+            node.imageView = VK_NULL_HANDLE;
+            node.image = VK_NULL_HANDLE;
+        }
+        vkFreeMemory(device, slot.memory, getHostCallbacks());
+        slot.memory = VK_NULL_HANDLE;
+        slot.size = 0;
+    }
+}
+
+void RenderGraph::retireTransients(DeletionQueue &deletionQueue, uint64_t value){
+    for (auto &slot : aliasSlots) {
+        for (Resource r : slot.resources) {
+            ResourceNode &node = resources[r];
+            deletionQueue.destroyImageView(node.imageView, value);
+            deletionQueue.destroyImage(node.image, value);
+            node.imageView = VK_NULL_HANDLE;
+            node.image = VK_NULL_HANDLE;
+        }
+        deletionQueue.freeMemory(slot.memory, value);
+        slot.memory = VK_NULL_HANDLE;
+        slot.size = 0;
+    }
+}
+
+VkImage RenderGraph::getImage(Resource resource){
+    return resources[resource].image;
+}
+
+VkImageView RenderGraph::getImageView(Resource resource){
+    return resources[resource].imageView;
+}
+
+VkDeviceSize RenderGraph::getTransientMemorySize(){
+    VkDeviceSize total = 0;
+    for (const auto &slot : aliasSlots) {
+        total += slot.size;
+    }
+    return total;
+}
+
+VkDeviceSize RenderGraph::getCommittedMemorySize(VkDevice device){
+    VkDeviceSize total = 0;
+    for (const auto &slot : aliasSlots) {
+        if (slot.lazy) {
+            VkDeviceSize committed = 0;
+            vkGetDeviceMemoryCommitment(device, slot.memory, &committed);
+            total += committed;
+        } else {
+            total += slot.size;
+        }
+    }
+    return total;
+}
+
+void RenderGraph::bindImage(Resource resource, VkImage image){
+    resources[resource].image = image;
+}
+
+void RenderGraph::bindBuffer(Resource resource, VkBuffer buffer){
+    resources[resource].buffer = buffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer, FrameArena &arena, const std::function<void(Pass)> &recordPass){
+    for (const auto &compiled : compiledPasses) {
+        recordBarriers(commandBuffer, arena, compiled.barriers);
+        recordPass(compiled.pass);
+    }
+    recordBarriers(commandBuffer, arena, finalBarriers);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, FrameArena &arena, const std::vector<Barrier> &barriers){
+    if (barriers.empty()) {
+        return;
+    }
+
+    // one vkCmdPipelineBarrier per pass
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+    ArenaVector<VkImageMemoryBarrier> imageBarriers{ArenaAllocator<VkImageMemoryBarrier>(arena)};
+    ArenaVector<VkBufferMemoryBarrier> bufferBarriers{ArenaAllocator<VkBufferMemoryBarrier>(arena)};
+    imageBarriers.reserve(barriers.size());
+    bufferBarriers.reserve(barriers.size());
+
+    for (const auto &barrier : barriers) {
+        const ResourceNode &node = resources[barrier.resource];
+        srcStages |= barrier.srcStage;
+        dstStages |= barrier.dstStage;
+
+        if (node.isImage) {
+            if (node.image == VK_NULL_HANDLE) {
+                throw std::runtime_error("render graph: image " + node.name + " is not bound.");
+            }
+
+            VkImageMemoryBarrier imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = barrier.srcAccess;
+            imageBarrier.dstAccessMask = barrier.dstAccess;
+            imageBarrier.oldLayout = barrier.oldLayout;
+            imageBarrier.newLayout = barrier.newLayout;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = node.image;
+            imageBarrier.subresourceRange.aspectMask = node.info.aspect;
+            imageBarrier.subresourceRange.baseMipLevel = 0;
+            imageBarrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+            imageBarrier.subresourceRange.baseArrayLayer = 0;
+            imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            imageBarriers.push_back(imageBarrier);
+        } else {
+            if (node.buffer == VK_NULL_HANDLE) {
+                throw std::runtime_error("render graph: buffer " + node.name + " is not bound.");
+            }
+
+            VkBufferMemoryBarrier bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = barrier.srcAccess;
+            bufferBarrier.dstAccessMask = barrier.dstAccess;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = node.buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            bufferBarriers.push_back(bufferBarrier);
+        }
+    }
+
+    vkCmdPipelineBarrier(commandBuffer,
+                         srcStages, dstStages,
+                         0,
+                         0, nullptr,
+                         static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                         static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
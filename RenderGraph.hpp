@@ -0,0 +1,187 @@
+#ifndef RenderGraph_hpp
+#define RenderGraph_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DeletionQueue.hpp"
+#include "FrameArena.hpp"
+
+// how a pass touches a resource, each maps to a fixed stage / access / layout triple
+enum class ResourceUsage {
+    ColorAttachment,
+    DepthAttachment,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+    IndirectRead,
+    VertexRead,
+    Present
+};
+
+// Declarative description of a frame. Passes are declared in execution order together with the images and
+// buffers they read and write. compile() then
+//  - culls passes whose results never reach an output,
+//  - walks the surviving passes tracking each resource's layout, last writer and readers, and emits only the
+//    barriers needed for layout changes and read/write hazards,
+//  - lets transient images with disjoint lifetimes share one memory allocation.
+// compile() makes no Vulkan calls, so the compiled barrier lists can be checked on the CPU.
+class RenderGraph{
+public:
+    typedef uint32_t Resource;
+    typedef uint32_t Pass;
+
+    struct ImageInfo {
+        VkFormat format;
+        VkExtent2D extent;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags usage;
+        VkImageAspectFlags aspect;
+    };
+
+    struct Barrier {
+        Resource resource;
+        VkPipelineStageFlags srcStage;
+        VkPipelineStageFlags dstStage;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+        VkImageLayout oldLayout;            // both UNDEFINED for buffers
+        VkImageLayout newLayout;
+    };
+
+    struct CompiledPass {
+        Pass pass;
+        std::vector<Barrier> barriers;      // recorded before the pass
+    };
+
+    RenderGraph();
+
+    // drops every declaration, transients have to be destroyed first
+    void reset();
+
+    // external image, e.g. a swapchain image. initialStage is where the previous user (or the acquire wait) is.
+    Resource importImage(const std::string &name, VkImageAspectFlags aspect, VkImageLayout initialLayout, VkPipelineStageFlags initialStage);
+    Resource importBuffer(const std::string &name, VkPipelineStageFlags initialStage, VkAccessFlags initialAccess);
+    // image owned by the graph, contents do not survive the frame
+    Resource createTransientImage(const std::string &name, const ImageInfo &info);
+
+    Pass addPass(const std::string &name);
+    void read(Pass pass, Resource resource, ResourceUsage usage);
+    void write(Pass pass, Resource resource, ResourceUsage usage);
+    // the resource is consumed after the graph in finalUsage, its writers are never culled
+    void markOutput(Resource resource, ResourceUsage finalUsage);
+
+    void compile();
+
+    // compile results
+    const std::vector<CompiledPass>& getCompiledPasses();
+    const std::vector<Barrier>& getFinalBarriers();
+    bool isCulled(Pass pass);
+    uint32_t getAliasSlot(Resource resource);
+    uint32_t getAliasSlotCount();
+    const std::string& getName(Resource resource);
+
+    // GPU side. Transients are created with the given memory properties, falling back to DEVICE_LOCAL.
+    void allocateTransients(VkPhysicalDevice physicalDevice, VkDevice device, VkMemoryPropertyFlags memoryProperties);
+    void destroyTransients(VkDevice device);
+    // hands the transients to the deletion queue, frames in flight may still render into them
+    void retireTransients(DeletionQueue &deletionQueue, uint64_t value);
+    VkImage getImage(Resource resource);
+    VkImageView getImageView(Resource resource);
+    VkDeviceSize getTransientMemorySize();
+    // lazily allocated slots only count what the implementation has committed so far
+    VkDeviceSize getCommittedMemorySize(VkDevice device);
+
+    void bindImage(Resource resource, VkImage image);
+    void bindBuffer(Resource resource, VkBuffer buffer);
+    // records barriers and calls recordPass for every surviving pass in order. Barrier arrays come from arena.
+    void execute(VkCommandBuffer commandBuffer, FrameArena &arena, const std::function<void(Pass)> &recordPass);
+
+private:
+    struct Access {
+        Resource resource;
+        VkPipelineStageFlags stage;
+        VkAccessFlags access;
+        VkImageLayout layout;
+        bool read;
+        bool write;
+    };
+
+    // tracked while walking the passes
+    struct ResourceState {
+        VkImageLayout layout;
+        VkPipelineStageFlags writeStage;    // last writer, or the last transition
+        VkAccessFlags writeAccess;
+        VkPipelineStageFlags readStages;    // readers since the last write
+        VkPipelineStageFlags visibleStages; // readers the last write was already made visible to
+        VkAccessFlags visibleAccess;
+    };
+
+    struct ResourceNode {
+        std::string name;
+        bool isImage;
+        bool transient;
+        ImageInfo info;
+
+        // state before the first pass
+        VkImageLayout initialLayout;
+        VkPipelineStageFlags initialStage;
+        VkAccessFlags initialAccess;
+
+        bool output = false;
+        Access finalAccess;
+
+        // filled by compile()
+        uint32_t aliasSlot = UINT32_MAX;
+        uint32_t firstUse;
+        uint32_t lastUse;
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+    };
+
+    struct PassNode {
+        std::string name;
+        std::vector<Access> accesses;
+        bool culled = false;
+    };
+
+    struct AliasSlot {
+        std::vector<Resource> resources;    // in order of first use
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        bool lazy = false;
+    };
+
+    std::vector<ResourceNode> resources;
+    std::vector<PassNode> passes;
+    std::vector<AliasSlot> aliasSlots;
+
+    std::vector<CompiledPass> compiledPasses;
+    std::vector<Barrier> finalBarriers;
+
+    void addAccess(Pass pass, Resource resource, ResourceUsage usage, bool write);
+    Access getUsageAccess(Resource resource, ResourceUsage usage, bool write);
+    void cullPasses();
+    void assignAliasSlots();
+    void compileBarriers();
+    bool trackAccess(ResourceState &state, const Access &access, Barrier &barrier);
+    void recordBarriers(VkCommandBuffer commandBuffer, FrameArena &arena, const std::vector<Barrier> &barriers);
+};
+
+#endif /* RenderGraph_hpp */
@@ -2,8 +2,23 @@
 
 #include "Renderer.hpp"
 
-void Renderer::init(GLFWwindow* window){
+void Renderer::init(GLFWwindow* window, RendererSettings newSettings){
     wd = window;
+    settings = newSettings;
+    settings.framesInFlight = std::clamp(settings.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+    frames.resize(settings.framesInFlight);
+    resolutionController = ResolutionController(settings.targetFrameTime, settings.minResolutionScale, 1.0f, 0.05f);
+    depthPrepassRequest = settings.depthPrepass;
+    
+    // later sizes come from setFramebufferSize(), GLFW only answers on the main thread
+    int width, height;
+    glfwGetFramebufferSize(wd, &width, &height);
+    framebufferWidth = width;
+    framebufferHeight = height;
+    
+    jobSystem.start(settings.jobWorkers);
+    // every Vulkan object, the instance included, is created and destroyed with the same callbacks
+    getHostAllocator().setEnabled(settings.hostAllocator);
 
     try {
         createInstance();
@@ -11,24 +26,34 @@ void Renderer::init(GLFWwindow* window){
         createSurface();
         selectPhysicalDevice();
         createLogicalDevice();
+        depthFormat = findDepthFormat();
         createSwapchain();
         createImageViews();
-        createRenderPass();
+        if (!dynamicRendering) {
+            createRenderPass();
+        }
         createDescriptorSetLayout();
         createPushConstantRange();
+        pipelineLibrary.start(device, settings.pipelineWorkers, PIPELINE_CACHE_PATH);
         createGraphicsPipeline();
+        createCullPipeline();
         createCommandPool();
-        createColorBuffer();
-        createDepthBuffer();
-        createFramebuffers();
+        createFrameGraph();
+        if (!dynamicRendering) {
+            createFramebuffers();
+        }
         createTextureSampler();
         createUniformBuffers();
-        updateUniformBuffers();
+        createTransformBuffers();
+        createCullBuffers();
         createDescriptorPool();
         createSamplerDescriptorPool();
         createDescriptorSets();
         createCommandBuffers();
         createSynchronizations();
+        createTimestampQueries();
+        createStatisticsQueries();
+        createPlaceholderAssets();
     }
     catch (std::exception &err){
         std::cerr << "std::exception: " << err.what() << std::endl;
@@ -38,181 +63,804 @@ void Renderer::init(GLFWwindow* window){
         std::cerr << "unknown error\n";
         exit(-1);
     }
+    
+    uint32_t workers = settings.streamingWorkers;
+    if (workers == 0) {
+        workers = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    }
+    assetStreamer.start(workers, &jobSystem);
+}
+
+ModelHandle Renderer::createMeshModel(std::string modelFile, std::string textureFile, ModelHandle parentModel){
+    uint32_t parentNode = SceneGraph::NO_PARENT;
+    if(!parentModel.isNull()){
+        MeshModel *parent = models.get(parentModel);
+        if(parent == nullptr){
+            throw std::runtime_error("attempted to parent a model to an invalid model handle.");
+        }
+        parentNode = parent->getNodeId();
+    }
+    
+    MeshModel meshModel = MeshModel({}, sceneGraph.createNode(parentNode));
+    std::string pathKey = modelFile + "\n" + textureFile;
+    
+    // loaded before, the new model shares its buffers and textures
+    uint64_t assetKey = 0;
+    ModelAsset *asset = modelCache.acquirePath(pathKey, assetKey);
+    if (asset != nullptr) {
+        meshModel.setMeshes(asset->meshes);
+        meshModel.setAsset(assetKey);
+        sceneRevision++;
+        return models.insert(meshModel);
+    }
+    
+    uint64_t request;
+    auto inFlight = streamingPaths.find(pathKey);
+    if (inFlight != streamingPaths.end()) {
+        request = inFlight->second;
+    } else {
+        StreamingRequest streaming;
+        streaming.pathKey = pathKey;
+        streaming.modelFile = modelFile;
+        streaming.textureFile = textureFile;
+        
+        // new nodes sit at the origin, updateStreamingPriorities() follows them once they are placed
+        request = assetStreamer.request(modelFile, textureFile, glm::length(cameraPosition));
+        streamingRequests[request] = streaming;
+        streamingPaths[pathKey] = request;
+    }
+    
+    meshModel.setState(AssetState::Loading);
+    meshModel.setStreamRequest(request);
+    
+    ModelHandle modelHandle = models.insert(meshModel);
+    streamingRequests[request].models.push_back(modelHandle);
+    sceneRevision++;
+    
+    return modelHandle;
+}
+
+void Renderer::unloadMeshModel(ModelHandle modelHandle){
+    MeshModel *model = models.get(modelHandle);
+    if(model == nullptr){
+        return;
+    }
+    
+    // nothing waits: the next submit may still record upload acquires for these resources, so they are
+    // released one timeline value later than anything already submitted
+    uint64_t retireValue = graphicsTimeline.lastSubmitted + 1;
+    
+    if (model->getState() == AssetState::Loading) {
+        cancelStreaming(modelHandle, model->getStreamRequest());
+    }
+    if (model->getAsset() != 0) {
+        releaseModelAsset(model->getAsset(), retireValue);
+    }
+    sceneGraph.destroyNode(model->getNodeId());
+    models.remove(modelHandle);
+    
+    // cached command buffers and draw lists still reference the model
+    sceneRevision++;
+}
+
+void Renderer::releaseTexture(uint64_t textureKey, uint64_t retireValue){
+    TextureHandle texture;
+    std::vector<std::string> paths;
+    if (textureKey != 0 && textureCache.release(textureKey, texture, &paths)) {
+        for (auto &path : paths) {
+            assetStreamer.removeResidentTexture(path);
+        }
+        unloadTexture(texture, retireValue);
+    }
+}
+
+void Renderer::releaseModelAsset(uint64_t assetKey, uint64_t retireValue){
+    ModelAsset asset;
+    if (!modelCache.release(assetKey, asset)) {
+        return;
+    }
+    for (auto &mesh : asset.meshes) {
+        mesh.retireBuffers(deletionQueue, retireValue);
+    }
+    for (uint64_t textureKey : asset.textures) {
+        releaseTexture(textureKey, retireValue);
+    }
+}
+
+void Renderer::unloadTexture(TextureHandle textureHandle, uint64_t retireValue){
+    Texture *texture = textures.get(textureHandle);
+    if (texture == nullptr) {
+        return;
+    }
+    
+    deletionQueue.freeDescriptorSet(samplerDescriptorPool, texture->descriptorSet, retireValue);
+    deletionQueue.destroyImageView(texture->imageView, retireValue);
+    deletionQueue.destroyImage(texture->image, retireValue);
+    deletionQueue.freeMemory(texture->memory, retireValue);
+    
+    textures.remove(textureHandle);
+}
+
+bool Renderer::isModelLoaded(ModelHandle modelHandle){
+    return models.contains(modelHandle);
+}
+
+AssetState Renderer::getModelState(ModelHandle modelHandle){
+    MeshModel *model = models.get(modelHandle);
+    if(model == nullptr){
+        return AssetState::Failed;
+    }
+    return model->getState();
 }
 
-int Renderer::createMeshModel(std::string modelFile){
-    std::vector<std::string> textureNames = MeshModel::LoadMaterials();
+void Renderer::createPlaceholderAssets(){
+    // grey checker, the first texture so meshes without one can use it
+    const unsigned char light = 200;
+    const unsigned char dark = 120;
+    std::array<unsigned char, 16> pixels = {
+        light, light, light, 255,   dark, dark, dark, 255,
+        dark, dark, dark, 255,      light, light, light, 255
+    };
+    placeholderTexture = createTexture(pixels.data(), 2, 2);
+    
+    // unit cube around the origin
+    std::vector<Vertex> vertices(8);
+    for (uint32_t i = 0; i < 8; i++) {
+        vertices[i].pos = glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+        vertices[i].color = glm::vec3(1.0f);
+        vertices[i].texCoord = glm::vec2((i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f);
+    }
+    std::vector<uint32_t> indices = {
+        0, 2, 1,  1, 2, 3,      // -z
+        4, 5, 6,  5, 7, 6,      // +z
+        0, 1, 4,  1, 5, 4,      // -y
+        2, 6, 3,  3, 6, 7,      // +y
+        0, 4, 2,  2, 4, 6,      // -x
+        1, 3, 5,  3, 7, 5       // +x
+    };
+    placeholderMesh = Mesh(physicalDevice, device, uploader, queueFamilyIndices, vertices, indices, static_cast<int>(placeholderTexture.index));
+}
+
+void Renderer::processStreamedAssets(){
+    std::vector<AssetStreamer::Result> results;
+    assetStreamer.collect(results, settings.streamingUploadsPerFrame);
     
-    std::vector<int> matToTex(textureNames.size());
-    for(size_t i = 0; i < textureNames.size(); ++i){
-        if(textureNames[i].empty()){
-            matToTex[i] = 0;                                // texture 0 reserved for default texture.
+    for (auto &result : results) {
+        auto streaming = streamingRequests.find(result.request);
+        if (streaming == streamingRequests.end()) {
+            continue;                                   // every model waiting for it was unloaded
+        }
+        StreamingRequest request = std::move(streaming->second);
+        streamingRequests.erase(streaming);
+        streamingPaths.erase(request.pathKey);
+        
+        finishStreamingRequest(request, result);
+    }
+}
+
+bool Renderer::acquireStreamedTextures(AssetStreamer::Result &result, std::vector<uint64_t> &textureKeys){
+    for (auto &texture : result.textures) {
+        uint64_t textureKey = 0;
+        if (texture.resident) {
+            // skipped by the streamer, gone if it was released since
+            if (textureCache.acquirePath(texture.file, textureKey) == nullptr) {
+                return false;
+            }
+        } else if (textureCache.acquire(texture.hash) != nullptr) {
+            // the same image under another path is found by its contents
+            textureKey = texture.hash;
+            textureCache.addPath(textureKey, texture.file);
+            assetStreamer.addResidentTexture(texture.file);
+        } else if (textures.getSize() >= MAX_OBJECTS) {
+            result.error = "number of textures created exceeds the MAX_OBJECTS";
+            return false;
         } else {
-            matToTex[i] = createTexture(textureNames[i]);   // create texture and set value to index of next texture
+            // only the copy is queued here, the frame's submission picks up its acquire
+            textureKey = texture.hash;
+            textureCache.insert(textureKey, texture.file, createTexture(texture.pixels.data(), texture.width, texture.height));
+            assetStreamer.addResidentTexture(texture.file);
+        }
+        textureKeys.push_back(textureKey);
+    }
+    return true;
+}
+
+void Renderer::finishStreamingRequest(StreamingRequest &request, AssetStreamer::Result &result){
+    uint64_t retireValue = graphicsTimeline.lastSubmitted + 1;
+    
+    // one reference per texture of the result, in the same order
+    std::vector<uint64_t> textureKeys;
+    if (result.error.empty() && !acquireStreamedTextures(result, textureKeys)) {
+        for (uint64_t textureKey : textureKeys) {
+            releaseTexture(textureKey, retireValue);
+        }
+        
+        if (result.error.empty()) {
+            // a texture the streamer skipped was released in the meantime, so the request starts over
+            uint64_t retry = assetStreamer.request(request.modelFile, request.textureFile, glm::length(cameraPosition));
+            for (ModelHandle modelHandle : request.models) {
+                models.get(modelHandle)->setStreamRequest(retry);
+            }
+            streamingPaths[request.pathKey] = retry;
+            streamingRequests[retry] = std::move(request);
+            return;
+        }
+    }
+    
+    if (!result.error.empty()) {
+        std::cerr << "failed to stream model: " << result.error << std::endl;
+        for (ModelHandle modelHandle : request.models) {
+            models.get(modelHandle)->setState(AssetState::Failed);
         }
+        return;
+    }
+    
+    uint64_t assetKey = result.modelHash;
+    for (uint64_t textureKey : textureKeys) {
+        assetKey = hashCombine(assetKey, textureKey);
+    }
+    
+    ModelAsset *asset = modelCache.acquire(assetKey);
+    if (asset != nullptr) {
+        // identical files under other paths, the asset already holds its own texture references
+        for (uint64_t textureKey : textureKeys) {
+            releaseTexture(textureKey, retireValue);
+        }
+        modelCache.addPath(assetKey, request.pathKey);
+    } else {
+        ModelAsset newAsset;
+        newAsset.textures = textureKeys;
+        for (auto &subMesh : result.meshes) {
+            int texId = -1;                             // untextured, drawn with vertex colors
+            if (subMesh.material >= 0) {
+                texId = static_cast<int>(textureCache.find(textureKeys[subMesh.material])->index);
+            }
+            newAsset.meshes.push_back(Mesh(physicalDevice, device, uploader, queueFamilyIndices, subMesh.vertices, subMesh.indices, texId));
+        }
+        asset = modelCache.insert(assetKey, request.pathKey, newAsset);
+    }
+    
+    // one reference per model, the first was taken above
+    for (size_t i = 0; i < request.models.size(); ++i) {
+        if (i > 0) {
+            modelCache.acquire(assetKey);
+        }
+        MeshModel *model = models.get(request.models[i]);
+        model->setMeshes(asset->meshes);
+        model->setAsset(assetKey);
+        model->setState(AssetState::Ready);
+    }
+    sceneRevision++;
+}
+
+void Renderer::cancelStreaming(ModelHandle modelHandle, uint64_t request){
+    auto streaming = streamingRequests.find(request);
+    if (streaming == streamingRequests.end()) {
+        return;
+    }
+    
+    // the files are still loaded while other models wait for them
+    std::vector<ModelHandle> &waiting = streaming->second.models;
+    waiting.erase(std::remove(waiting.begin(), waiting.end(), modelHandle), waiting.end());
+    if (!waiting.empty()) {
+        return;
     }
     
-    std::vector<Mesh> modelMeshes = MeshModel::LoadMeshes(physicalDevice, device, transferQueue, transferCommandPool, queueFamilyIndices, matToTex);
-    MeshModel meshModel = MeshModel(modelMeshes);
-    modelList.push_back(meshModel);
+    assetStreamer.cancel(request);
+    streamingPaths.erase(streaming->second.pathKey);
+    streamingRequests.erase(streaming);
+}
+
+void Renderer::updateStreamingPriorities(FrameArena &arena){
+    if (streamingRequests.empty()) {
+        return;
+    }
     
-    return static_cast<int>(modelList.size() - 1);}
+    // a request shared by several models goes by the nearest one
+    const glm::mat4 *worldMatrices = sceneGraph.getWorldMatrices();
+    ArenaVector<std::pair<uint64_t, float>> priorities{ArenaAllocator<std::pair<uint64_t, float>>(arena)};
+    priorities.reserve(streamingRequests.size());
+    for (auto &streaming : streamingRequests) {
+        float distance = std::numeric_limits<float>::max();
+        for (ModelHandle modelHandle : streaming.second.models) {
+            glm::vec3 position = glm::vec3(worldMatrices[models.get(modelHandle)->getNodeId()][3]);
+            distance = std::min(distance, glm::distance(cameraPosition, position));
+        }
+        priorities.push_back({ streaming.first, distance });
+    }
+    assetStreamer.setPriorities(priorities.data(), priorities.size());
+}
+
+size_t Renderer::getDrawMeshCount(MeshModel &model){
+    return model.getState() == AssetState::Ready ? model.getMeshCount() : 1;
+}
+
+Mesh* Renderer::getDrawMesh(MeshModel &model, size_t index){
+    return model.getState() == AssetState::Ready ? model.getMesh(index) : &placeholderMesh;
+}
 
-void Renderer::updateModel(int modelId){
-    if(modelId >= modelList.size()){
+void Renderer::setModelTransform(ModelHandle modelHandle, glm::vec3 position, glm::quat rotation, glm::vec3 scale){
+    MeshModel *model = models.get(modelHandle);
+    if(model == nullptr){
         return;
     }
-    modelList[modelId].updateModel();
+    
+    uint32_t node = model->getNodeId();
+    sceneGraph.setPosition(node, position);
+    sceneGraph.setRotation(node, rotation);
+    sceneGraph.setScale(node, scale);
+}
+
+FrameSnapshot& Renderer::beginSnapshot(){
+    return snapshots.getWriteBuffer();
+}
+
+void Renderer::publishSnapshot(){
+    snapshots.publish();
+}
+
+void Renderer::applySnapshot(){
+    auto snapshotStart = std::chrono::high_resolution_clock::now();
+    const FrameSnapshot *snapshot = snapshots.acquire();
+    if (snapshot != nullptr) {
+        cameraPosition = snapshot->cameraPosition;
+        for (const ModelTransform &transform : snapshot->transforms) {
+            setModelTransform(transform.model, transform.position, transform.rotation, transform.scale);
+        }
+        frameStats.snapshotsApplied++;
+    }
+    frameStats.snapshotTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - snapshotStart).count();
 }
 
 void Renderer::draw(){
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    // minimized, there is nothing to present until the window has a size again
+    if (framebufferWidth == 0 || framebufferHeight == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return;
+    }
+    
+    auto frameStart = std::chrono::high_resolution_clock::now();
+    uint64_t allocationsStart = getThreadAllocationCount();
+    FrameResources &frame = frames[currentFrame];
+    
+    waitTimeline(device, graphicsTimeline, frame.timelineValue);
+    auto frameWaitEnd = std::chrono::high_resolution_clock::now();
+    frame.arena.reset();
+    
+    readTimestamps(frame);
+    readStatistics(frame);
+    frame.queriesPending = false;
+    
+    // resources retired by resizes and unloads
+    if (deletionQueue.getPendingCount() > 0) {
+        uint64_t completedValue = 0;
+        vkGetSemaphoreCounterValue(device, graphicsTimeline.semaphore, &completedValue);
+        deletionQueue.flush(completedValue);
+    }
+    
+    // staging memory of finished transfers, then this frame's share of streamed models
+    uploader.collect();
+    processStreamedAssets();
+    
+    // recorded command buffers still use the fallbacks of newly compiled variants
+    if (pipelineLibrary.collect() > 0) {
+        sceneRevision++;
+    }
+    
+    // requests from other threads
+    bool depthPrepass = depthPrepassRequest;
+    if (depthPrepass != settings.depthPrepass) {
+        settings.depthPrepass = depthPrepass;
+        sceneRevision++;
+    }
+    applySnapshot();
+    
+    frame.commandAllocator.reset();
+    auto poolResetEnd = std::chrono::high_resolution_clock::now();
     
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
     
-    // driver not guaranteed to output error out of data for surface
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        recreateSwapchain();
+    // a suboptimal image is still acquired and its semaphore signaled, so the frame goes on and the
+    // swapchain is recreated after present
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
         framebufferResized = false;
+        recreateSwapchain();
         return;
+    } else if (result == VK_SUBOPTIMAL_KHR) {
+        framebufferResized = true;
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to acquire swap chain image.");
     }
     
-    if(imagesInFlight[imageIndex] != VK_NULL_HANDLE){
-        vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+    // reaching the frame's timeline value guarantees the GPU is done with everything this frame owns
+    updateUniformBuffer(frame);
+    updateTransforms(frame);
+    updateStreamingPriorities(frame.arena);
+    updateDrawList(frame.arena);
+    updateCulling(frame);
+    
+    SubmitBatch batch(frame.arena);
+    batch.waitSemaphores.push_back(frame.imageAvailableSemaphore);
+    batch.waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    batch.waitValues.push_back(0);
+    
+    // async, the culling overlaps whatever the graphics queue still has in flight from earlier frames
+    recordCulling(frame, computeScheduler.begin(static_cast<uint32_t>(currentFrame)));
+    computeScheduler.end(static_cast<uint32_t>(currentFrame), VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, batch);
+    
+    // a cached buffer only references the frame's own descriptor set and the image's framebuffer,
+    // so it can be resubmitted as is while nothing it was recorded against has changed
+    if (settings.cacheCommandBuffers) {
+        frame.commandBuffer = frame.cachedCommandBuffers[imageIndex];
+        if (frame.cachedRevisions[imageIndex] != sceneRevision) {
+            recordCommands(frame, imageIndex, frame.commandBuffer, 0);
+            frame.cachedRevisions[imageIndex] = sceneRevision;
+            frameStats.recordedFrames++;
+        }
+    } else {
+        frame.commandBuffer = frame.commandAllocator.allocate();
+        recordCommands(frame, imageIndex, frame.commandBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        frameStats.recordedFrames++;
     }
-    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+    // ownership acquires and mip generation of finished uploads go first, after the transfer queue's work
+    if (uploader.hasPendingAcquires()) {
+        VkCommandBuffer uploadCommandBuffer = frame.commandAllocator.allocate();
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(uploadCommandBuffer, &beginInfo);
+        uploader.recordAcquires(uploadCommandBuffer);
+        vkEndCommandBuffer(uploadCommandBuffer);
+        
+        batch.commandBuffers.push_back(uploadCommandBuffer);
+    }
+    // also for plain buffer uploads on a shared family, which record no acquire: being submitted earlier on the
+    // same queue does not make the copy visible to the draws
+    uint64_t uploadValue = uploader.takeGraphicsWait();
+    if (uploadValue != 0) {
+        batch.waitSemaphores.push_back(uploader.getTimeline().semaphore);
+        batch.waitStages.push_back(Uploader::GRAPHICS_WAIT_STAGES);
+        batch.waitValues.push_back(uploadValue);
+    }
+    batch.commandBuffers.push_back(frame.commandBuffer);
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    std::vector<VkPipelineStageFlags> waitStages = {
-        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
-    };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &imageAvailableSemaphores[currentFrame];
-    submitInfo.pWaitDstStageMask = waitStages.data();
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &renderFinishedSemaphores[currentFrame];
-    
-    recordCommands(imageIndex);
-    
-    vkResetFences(device, 1, &inFlightFences[currentFrame]);
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(batch.waitSemaphores.size());
+    submitInfo.pWaitSemaphores = batch.waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = batch.waitStages.data();
+    submitInfo.commandBufferCount = static_cast<uint32_t>(batch.commandBuffers.size());
+    submitInfo.pCommandBuffers = batch.commandBuffers.data();
+    
+    // the binary semaphore feeds present, the timeline value marks the frame's resources as reusable
+    std::array<VkSemaphore, 2> signalSemaphores = { frame.renderFinishedSemaphore, graphicsTimeline.semaphore };
+    std::array<uint64_t, 2> signalValues = { 0, graphicsTimeline.lastSubmitted + 1 };    // binary value ignored
+    
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(batch.waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = batch.waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+    
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    frame.timelineValue = ++graphicsTimeline.lastSubmitted;
+    frame.queriesPending = true;
     
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+    presentInfo.pWaitSemaphores = &frame.renderFinishedSemaphore;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swapchain;
     presentInfo.pImageIndices = &imageIndex;
     
     result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    
+    currentFrame = (currentFrame + 1) % frames.size();
+    
+    auto frameEnd = std::chrono::high_resolution_clock::now();
+    frameStats.frameCount++;
+    frameStats.cpuTime += std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+    frameStats.frameWaitTime += std::chrono::duration<double, std::milli>(frameWaitEnd - frameStart).count();
+    frameStats.commandPoolResetTime += std::chrono::duration<double, std::milli>(poolResetEnd - frameWaitEnd).count();
+    frameStats.heapAllocations += getThreadAllocationCount() - allocationsStart;
+    frameStats.frameArenaPeak = std::max(frameStats.frameArenaPeak, frame.arena.getUsed());
+    if (resizePending && result == VK_SUCCESS) {
+        frameStats.resizeCount++;
+        frameStats.resizeLatency += std::chrono::duration<double, std::milli>(frameEnd - resizeStart).count();
+        resizePending = false;
+    }
 
     // driver not guaranteed to output error out of data for surface
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized.exchange(false)) {
         recreateSwapchain();
-        framebufferResized = false;
-        return;
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to present swap chain image.");
     }
+}
+
+void Renderer::updateUniformBuffer(FrameResources &frame){
+    UniformBufferObject ubo{};
+    ubo.view = glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float) swapchainExtent.height, Z_NEAR, Z_FAR);
+    ubo.proj[1][1] *= -1;
+    
+    memcpy(frame.uniformData, &ubo, sizeof(ubo));
+    
+    // Gribb/Hartmann plane extraction, rows of the view-projection matrix. Depth range is [0, 1].
+    glm::mat4 viewProj = ubo.proj * ubo.view;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    glm::vec4 *planes = frame.cullConstants.frustumPlanes;
+    planes[0] = rows[3] + rows[0];      // left
+    planes[1] = rows[3] - rows[0];      // right
+    planes[2] = rows[3] + rows[1];      // bottom
+    planes[3] = rows[3] - rows[1];      // top
+    planes[4] = rows[2];                // near
+    planes[5] = rows[3] - rows[2];      // far
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+void Renderer::updateDrawList(FrameArena &arena){
+    bool rebuilt = drawListRevision != sceneRevision;
+    if (rebuilt) {
+        drawList.clear();
+        ArenaMap<VkBuffer, uint32_t> meshIds(0, ArenaAllocator<std::pair<const VkBuffer, uint32_t>>(arena));
+        for (uint32_t j = 0; j < models.getSlotCount(); ++j) {
+            if (!models.isAlive(j)) {
+                continue;                               // unloaded, the slot waits for reuse
+            }
+            MeshModel &model = models.at(j);
+            for (size_t i = 0; i < getDrawMeshCount(model); ++i) {
+                Mesh *mesh = getDrawMesh(model, i);
+                uint32_t meshId = meshIds.emplace(mesh->getVertexBuffer(), static_cast<uint32_t>(meshIds.size())).first->second;
+                // untextured meshes still bind a texture, the pipeline variant does not sample it
+                int texId = mesh->getTexId();
+                uint32_t variant = texId >= 0 ? PIPELINE_VARIANT_TEXTURED : 0;
+                if (texId < 0) {
+                    texId = static_cast<int>(placeholderTexture.index);
+                }
+                drawList.push_back({ *mesh, model.getNodeId(), texId, variant, meshId });
+            }
+        }
+        drawListRevision = sceneRevision;
+    }
+    
+    auto sortStart = std::chrono::high_resolution_clock::now();
+    sortDrawList();
+    frameStats.sortTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sortStart).count();
+    
+    // recorded command buffers and culling inputs follow the order
+    if (!rebuilt && sortedOrder != drawOrder) {
+        sceneRevision++;
+        drawListRevision = sceneRevision;
+    }
+    drawOrder.swap(sortedOrder);
+}
+
+void Renderer::sortDrawList(){
+    // pipeline 8 bits | texture 16 | mesh 16 | depth 24, state changes dominate the order
+    const glm::mat4 *worldMatrices = sceneGraph.getWorldMatrices();
+    const float depthScale = static_cast<float>((1u << 24) - 1) / Z_FAR;
+    
+    sortKeys.resize(drawList.size());
+    sortedOrder.resize(drawList.size());
+    jobSystem.parallelFor(static_cast<uint32_t>(drawList.size()), DRAW_JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            DrawItem &item = drawList[i];
+            glm::vec4 sphere = item.mesh.getBoundingSphere();
+            glm::vec3 center = glm::vec3(worldMatrices[item.nodeId] * glm::vec4(glm::vec3(sphere), 1.0f));
+            float depth = std::clamp(glm::distance(cameraPosition, center), 0.0f, Z_FAR) * depthScale;
+            
+            sortKeys[i] = (static_cast<uint64_t>(item.pipelineId & 0xff) << 56) |
+                          (static_cast<uint64_t>(item.texId & 0xffff) << 40) |
+                          (static_cast<uint64_t>(item.meshId & 0xffff) << 24) |
+                          static_cast<uint64_t>(depth);
+            sortedOrder[i] = i;
+        }
+    });
+    
+    radixSort(sortKeys, sortedOrder, sortKeyScratch, sortOrderScratch);
+}
+
+void Renderer::updateCulling(FrameResources &frame){
+    if (frame.drawListRevision == sceneRevision) {
+        return;
+    }
+    
+    if (drawList.size() > MAX_DRAWS) {
+        throw std::runtime_error("number of meshes exceeds MAX_DRAWS.");
+    }
+    
+    uint32_t drawCount = static_cast<uint32_t>(drawOrder.size());
+    jobSystem.parallelFor(drawCount, DRAW_JOB_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            DrawItem &item = drawList[drawOrder[i]];
+            DrawCullInput input{};
+            input.boundingSphere = item.mesh.getBoundingSphere();
+            input.nodeIndex = item.nodeId;
+            input.indexCount = static_cast<uint32_t>(item.mesh.getIndexCount());
+            frame.drawInputData[i] = input;
+        }
+    });
     
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    frame.cullConstants.drawCount = drawCount;
+    frame.drawListRevision = sceneRevision;
 }
 
-void Renderer::updateUniformBuffers(){
-    for(uint32_t currentImage = 0; currentImage < swapchainImages.size(); ++currentImage){
-        UniformBufferObject ubo{};
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.proj = glm::perspective(glm::radians(45.0f), swapchainExtent.width / (float) swapchainExtent.height, 0.1f, 10.0f);
-        ubo.proj[1][1] *= -1;
+void Renderer::recordCulling(FrameResources &frame, VkCommandBuffer commandBuffer){
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &frame.cullDescriptorSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &frame.cullConstants);
+    
+    uint32_t groupCount = (frame.cullConstants.drawCount + 63) / 64;     // local_size_x of cull.comp
+    if (groupCount > 0) {
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    }
+}
 
-        void* data;
-        vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+void Renderer::updateTransforms(FrameResources &frame){
+    // dirty subtrees are recomputed once per frame; every slice then receives the changed nodes when its frame comes up.
+    if(sceneGraph.update()){
+        for(auto &otherFrame : frames){
+            sceneGraph.collectChanged(otherFrame.pendingTransforms);
+        }
     }
+    sceneGraph.writeMatrices(frame.pendingTransforms, frame.transformData);
+}
+
+FrameStats Renderer::getFrameStats(){
+    frameStats.resolutionScale = dynamicResolution ? resolutionController.getScale() : 1.0f;
+    frameStats.attachmentMemorySize = frameGraph.getTransientMemorySize();
+    frameStats.attachmentMemoryCommitted = frameGraph.getCommittedMemorySize(device);
+    frameStats.textureCount = textures.getSize();
+    frameStats.modelAssetCount = static_cast<uint32_t>(modelCache.getSize());
+    frameStats.pipelineCount = static_cast<uint32_t>(pipelineLibrary.getPipelineCount());
+    frameStats.snapshotsPublished = snapshots.getPublishedCount() - snapshotsPublishedAtReset;
+    
+    HostAllocator::Stats hostStats = getHostAllocator().getStats();
+    for (uint32_t i = 0; i < HostAllocator::SCOPE_COUNT; i++) {
+        frameStats.driverAllocations[i] = hostStats.allocations[i] - driverAllocationsAtReset[i];
+    }
+    frameStats.driverLiveBytes = hostStats.liveBytes;
+    frameStats.driverPooledBytes = hostStats.pooledBytes;
+    return frameStats;
 }
 
-void Renderer::setFramebufferResized(bool resized){
-    framebufferResized = resized;
+void Renderer::resetFrameStats(){
+    frameStats = FrameStats();
+    snapshotsPublishedAtReset = snapshots.getPublishedCount();
+    driverAllocationsAtReset = getHostAllocator().getStats().allocations;
+}
+
+void Renderer::setFramebufferSize(int width, int height){
+    framebufferWidth = width;
+    framebufferHeight = height;
+    framebufferResized = true;
+}
+
+void Renderer::setDepthPrepass(bool enabled){
+    // picked up by the next frame, both pipelines exist already and only the recorded commands change
+    depthPrepassRequest = enabled;
+}
+
+bool Renderer::isDepthPrepassEnabled(){
+    return depthPrepassRequest;
 }
 
 void Renderer::cleanUpSwapchain(){
     for (size_t i = 0; i < swapchainFramebuffers.size(); i++) {
-        vkDestroyFramebuffer(device, swapchainFramebuffers[i], nullptr);
+        vkDestroyFramebuffer(device, swapchainFramebuffers[i], getHostCallbacks());
     }
 
-    // free up existing command buffers => need to reallocate
-    vkFreeCommandBuffers(device, graphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    vkDestroyRenderPass(device, renderPass, nullptr);
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, getHostCallbacks());
+    vkDestroyRenderPass(device, renderPass, getHostCallbacks());
     
-    // clear color buffer
-    vkDestroyImageView(device, colorImageView, nullptr);
-    vkDestroyImage(device, colorImage, nullptr);
-    vkFreeMemory(device, colorImageMemory, nullptr);
-    
-    // clean depth buffer
-    vkDestroyImageView(device, depthBufferImageView, nullptr);
-    vkDestroyImage(device, depthBufferImage, nullptr);
-    vkFreeMemory(device, depthBufferImageMemory, nullptr);
+    // color and depth attachments
+    frameGraph.destroyTransients(device);
     
     for (size_t i = 0; i < swapchainImageViews.size(); i++) {
-        vkDestroyImageView(device, swapchainImageViews[i], nullptr);
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+        vkDestroyImageView(device, swapchainImageViews[i], getHostCallbacks());
     }
 
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+    vkDestroySwapchainKHR(device, swapchain, getHostCallbacks());
 }
 
 void Renderer::cleanUp(){
-    vkDeviceWaitIdle(device);
+    assetStreamer.stop();
+    jobSystem.stop();
     
-    for(size_t i = 0; i < modelList.size(); ++i){
-        modelList[i].destroyMeshModel();
+    vkDeviceWaitIdle(device);
+    deletionQueue.destroy();
+    
+    // models only hold copies of the shared meshes, textures are destroyed with the pool below
+    std::vector<ModelAsset> modelAssets;
+    modelCache.drain(modelAssets);
+    for (auto &asset : modelAssets) {
+        for (auto &mesh : asset.meshes) {
+            mesh.destroyBuffers();
+        }
     }
+    placeholderMesh.destroyBuffers();
         
-    vkDestroyDescriptorPool(device, samplerDescriptorPool, nullptr);
-    vkDestroyDescriptorSetLayout(device, samplerSetLayout, nullptr);
-    vkDestroySampler(device, textureSampler, nullptr);
+    vkDestroyDescriptorPool(device, samplerDescriptorPool, getHostCallbacks());
+    vkDestroyDescriptorSetLayout(device, samplerSetLayout, getHostCallbacks());
+    vkDestroySampler(device, textureSampler, getHostCallbacks());
+    
+    for(uint32_t i = 0; i < textures.getSlotCount(); ++i){
+        if(!textures.isAlive(i)){
+            continue;
+        }
+        Texture &texture = textures.at(i);
+        vkDestroyImageView(device, texture.imageView, getHostCallbacks());
+        vkDestroyImage(device, texture.image, getHostCallbacks());
+        vkFreeMemory(device, texture.memory, getHostCallbacks());
+    }
     
-    for(int i = 0; i < textureImages.size(); ++i){
-        vkDestroyImageView(device, textureImageViews[i], nullptr);
-        vkDestroyImage(device, textureImages[i], nullptr);
-        vkFreeMemory(device, textureImagesMemory[i], nullptr);
+    for (auto &frame : frames) {
+        vkDestroySemaphore(device, frame.renderFinishedSemaphore, getHostCallbacks());
+        vkDestroySemaphore(device, frame.imageAvailableSemaphore, getHostCallbacks());
+        frame.commandAllocator.destroy();
+        vkDestroyCommandPool(device, frame.cachedCommandPool, getHostCallbacks());
     }
     
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
+    vkDestroySemaphore(device, graphicsTimeline.semaphore, getHostCallbacks());
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, timestampQueryPool, getHostCallbacks());
     }
+    if (statisticsQueryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, statisticsQueryPool, getHostCallbacks());
+    }
+    
+    vkDestroyDescriptorPool(device, descriptorPool, getHostCallbacks());
+    
+    vkUnmapMemory(device, uniformBufferMemory);
+    vkDestroyBuffer(device, uniformBuffer, getHostCallbacks());
+    vkFreeMemory(device, uniformBufferMemory, getHostCallbacks());
+    
+    vkUnmapMemory(device, transformBufferMemory);
+    vkDestroyBuffer(device, transformBuffer, getHostCallbacks());
+    vkFreeMemory(device, transformBufferMemory, getHostCallbacks());
+    
+    vkUnmapMemory(device, drawInputBufferMemory);
+    vkDestroyBuffer(device, drawInputBuffer, getHostCallbacks());
+    vkFreeMemory(device, drawInputBufferMemory, getHostCallbacks());
+    vkDestroyBuffer(device, drawCommandBuffer, getHostCallbacks());
+    vkFreeMemory(device, drawCommandBufferMemory, getHostCallbacks());
+    
+    pipelineLibrary.destroy();
+    vkDestroyPipeline(device, cullPipeline, getHostCallbacks());
+    vkDestroyPipelineLayout(device, cullPipelineLayout, getHostCallbacks());
+    vkDestroyDescriptorSetLayout(device, cullSetLayout, getHostCallbacks());
     
     cleanUpSwapchain();
     
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, getHostCallbacks());
         
-    vkDestroyCommandPool(device, graphicsCommandPool, nullptr);
-    vkDestroyCommandPool(device, transferCommandPool, nullptr);
+    vkDestroyCommandPool(device, graphicsCommandPool, getHostCallbacks());
+    uploader.destroy();
+    computeScheduler.destroy();
 
-    vkDestroyDevice(device, nullptr);
+    vkDestroyDevice(device, getHostCallbacks());
     if (enableValidationLayers) {
-        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+        DestroyDebugUtilsMessengerEXT(instance, debugMessenger, getHostCallbacks());
     }
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    vkDestroyInstance(instance, nullptr);
+    vkDestroySurfaceKHR(instance, surface, getHostCallbacks());
+    vkDestroyInstance(instance, getHostCallbacks());
 }
 
 void Renderer::createInstance(){
@@ -252,21 +900,21 @@ void Renderer::createInstance(){
     }
 
     
-    VkResult result = vkCreateInstance(&createInfo, nullptr, &instance);
+    VkResult result = vkCreateInstance(&createInfo, getHostCallbacks(), &instance);
     if(result != VK_SUCCESS){
         throw std::runtime_error("failed to create vulkan instance.");
     }
 }
 
 void Renderer::createSurface(){
-    if(glfwCreateWindowSurface(instance, wd, nullptr, &surface) != VK_SUCCESS){
+    if(glfwCreateWindowSurface(instance, wd, getHostCallbacks(), &surface) != VK_SUCCESS){
         throw std::runtime_error("failed to create window surface.");
     }
 }
 
 void Renderer::createLogicalDevice(){
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::unordered_set<uint32_t> uniqueQueueFamilies = { queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.presentFamily.value() };
+    std::unordered_set<uint32_t> uniqueQueueFamilies = queueFamilyIndices.toSet();
     float queuePriority = 1.0f;
     
     for(uint32_t queueFamily : uniqueQueueFamilies){
@@ -278,17 +926,56 @@ void Renderer::createLogicalDevice(){
         queueCreateInfos.push_back(queueCreateInfo);
     }
     
+    // dynamic rendering when the device has it, otherwise the render pass path
+    dynamicRendering = settings.dynamicRendering && checkDynamicRenderingSupport();
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+    if (dynamicRendering) {
+        enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+    }
+    // cull mode and depth state set while recording, one pipeline serves both sides of the depth pre-pass
+    extendedDynamicState = settings.extendedDynamicState && checkExtendedDynamicStateSupport();
+    if (extendedDynamicState) {
+        enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+    }
+    
+    // pipeline statistics only feed FrameStats, a device without them still runs
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    pipelineStatistics = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+    
     VkPhysicalDeviceFeatures deviceFeatures {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.sampleRateShading = VK_TRUE;
+    deviceFeatures.pipelineStatisticsQuery = pipelineStatistics ? VK_TRUE : VK_FALSE;
+    
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+    
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures {};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures {};
+    extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+    
+    void **featureChain = &timelineFeatures.pNext;
+    if (dynamicRendering) {
+        *featureChain = &dynamicRenderingFeatures;
+        featureChain = &dynamicRenderingFeatures.pNext;
+    }
+    if (extendedDynamicState) {
+        *featureChain = &extendedDynamicStateFeatures;
+    }
     
     VkDeviceCreateInfo createInfo {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &timelineFeatures;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
         createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -296,42 +983,94 @@ void Renderer::createLogicalDevice(){
         createInfo.enabledLayerCount = 0;
     }
     
-    if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+    if (vkCreateDevice(physicalDevice, &createInfo, getHostCallbacks(), &device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
     
     vkGetDeviceQueue(device, queueFamilyIndices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, queueFamilyIndices.presentFamily.value(), 0, &presentQueue);
     vkGetDeviceQueue(device, queueFamilyIndices.transferFamily.value(), 0, &transferQueue);
+    vkGetDeviceQueue(device, queueFamilyIndices.computeFamily.value(), 0, &computeQueue);
+    
+    graphicsTimeline.queue = graphicsQueue;
+    graphicsTimeline.semaphore = createTimelineSemaphore(device);
+    
+    // extension commands are not exported by the loader under Vulkan 1.2
+    if (dynamicRendering) {
+        cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR");
+        cmdEndRendering = (PFN_vkCmdEndRenderingKHR) vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR");
+        if (cmdBeginRendering == nullptr || cmdEndRendering == nullptr) {
+            throw std::runtime_error("failed to load dynamic rendering commands!");
+        }
+    }
+    if (extendedDynamicState) {
+        cmdSetCullMode = (PFN_vkCmdSetCullModeEXT) vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT");
+        cmdSetDepthTestEnable = (PFN_vkCmdSetDepthTestEnableEXT) vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT");
+        cmdSetDepthWriteEnable = (PFN_vkCmdSetDepthWriteEnableEXT) vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT");
+        cmdSetDepthCompareOp = (PFN_vkCmdSetDepthCompareOpEXT) vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT");
+        if (cmdSetCullMode == nullptr || cmdSetDepthTestEnable == nullptr ||
+            cmdSetDepthWriteEnable == nullptr || cmdSetDepthCompareOp == nullptr) {
+            throw std::runtime_error("failed to load extended dynamic state commands!");
+        }
+    }
+    
+    deletionQueue = DeletionQueue(device);
 }
 
 void Renderer::recreateSwapchain(){
-    int width = 0, height = 0;
-    glfwGetFramebufferSize(wd, &width, &height);
-    while (width == 0 || height == 0) {
-        glfwGetFramebufferSize(wd, &width, &height);
-        glfwWaitEvents();
+    // minimized: draw() waits for a size, acquire reports the old swapchain out of date after that
+    if (framebufferWidth == 0 || framebufferHeight == 0) {
+        return;
     }
     
-    vkDeviceWaitIdle(device);
+    // measured up to the next successful present, a minimized window does not count
+    if (!resizePending) {
+        resizeStart = std::chrono::high_resolution_clock::now();
+        resizePending = true;
+    }
     
-    cleanUpSwapchain();
+    // no device idle: frames in flight keep rendering with the old resources, which are destroyed once the
+    // graphics timeline passes the last value submitted against them
+    uint64_t retireValue = graphicsTimeline.lastSubmitted;
+    for (auto framebuffer : swapchainFramebuffers) {
+        deletionQueue.destroyFramebuffer(framebuffer, retireValue);
+    }
+    for (auto imageView : swapchainImageViews) {
+        deletionQueue.destroyImageView(imageView, retireValue);
+    }
+    frameGraph.retireTransients(deletionQueue, retireValue);
     
-    createSwapchain();
+    VkSwapchainKHR oldSwapchain = swapchain;
+    VkFormat oldFormat = swapchainImageFormat;
+    createSwapchain(oldSwapchain);
+    deletionQueue.destroySwapchain(oldSwapchain, retireValue);
     createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createColorBuffer();
-    createDepthBuffer();
-    createFramebuffers();
-    createUniformBuffers();
-    updateUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
-}
-
-void Renderer::createSwapchain(){
+    
+    // with dynamic viewport and scissor only a format change invalidates the render pass and pipeline.
+    // Dynamic rendering pipelines are keyed by format, the old ones stay valid and new ones are added.
+    if (swapchainImageFormat != oldFormat) {
+        if (dynamicRendering) {
+            createPipelineVariants();
+        } else {
+            pipelineLibrary.retireAll(deletionQueue, retireValue);
+            deletionQueue.destroyPipelineLayout(pipelineLayout, retireValue);
+            deletionQueue.destroyRenderPass(renderPass, retireValue);
+            createRenderPass();
+            createGraphicsPipeline();
+        }
+    }
+    
+    createFrameGraph();
+    if (!dynamicRendering) {
+        createFramebuffers();
+    }
+    
+    // possibly a different image count, and every recorded buffer references old framebuffers
+    createCachedCommandBuffers();
+    sceneRevision++;
+}
+
+void Renderer::createSwapchain(VkSwapchainKHR oldSwapchain){
     SwapChainSupportDetails swapchainSupport = querySwapchainSupport(physicalDevice);
 
     VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapchainSupport.formats);
@@ -352,6 +1091,9 @@ void Renderer::createSwapchain(){
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (swapchainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;     // target of the dynamic resolution upscale
+    }
     
     std::vector<uint32_t> queueFamilyIndicesArr = {queueFamilyIndices.graphicsFamily.value(), queueFamilyIndices.presentFamily.value()};
     if (queueFamilyIndices.graphicsFamily != queueFamilyIndices.presentFamily) {
@@ -365,9 +1107,9 @@ void Renderer::createSwapchain(){
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;           // swapchain recreation during instance needs handle to old swapchain
+    createInfo.oldSwapchain = oldSwapchain;             // lets the presentation engine hand resources over, the old one is retired
  
-    if(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapchain) != VK_SUCCESS){
+    if(vkCreateSwapchainKHR(device, &createInfo, getHostCallbacks(), &swapchain) != VK_SUCCESS){
         throw std::runtime_error("failed to create swap chain.");
     }
     
@@ -377,6 +1119,7 @@ void Renderer::createSwapchain(){
 
     swapchainImageFormat = surfaceFormat.format;
     swapchainExtent = extent;
+    swapchainUsage = createInfo.imageUsage;
 }
 
 VkImageView Renderer::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels){
@@ -396,7 +1139,7 @@ VkImageView Renderer::createImageView(VkImage image, VkFormat format, VkImageAsp
     imageViewCreateInfo.subresourceRange.layerCount = 1;                        // swapchain image, representing left and right image view.
     
     VkImageView imageView;
-    if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView) != VK_SUCCESS) {
+    if (vkCreateImageView(device, &imageViewCreateInfo, getHostCallbacks(), &imageView) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image views!");
     }
     
@@ -412,24 +1155,27 @@ void Renderer::createImageViews(){
 }
 
 void Renderer::createRenderPass(){
+    // without multisampling the color attachment is the presented image and nothing is resolved
+    bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    
     VkAttachmentDescription colorAttachment{};
     colorAttachment.format = swapchainImageFormat;
     colorAttachment.samples = msaaSamples;
     colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;      // transitions are done by the frame graph
     colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         
     VkAttachmentDescription depthAttachment{};
-    depthAttachment.format = findDepthFormat();
+    depthAttachment.format = depthFormat;
     depthAttachment.samples = msaaSamples;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     
     VkAttachmentDescription colorAttachmentResolve{};
@@ -439,10 +1185,13 @@ void Renderer::createRenderPass(){
     colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
-    std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
+    std::vector<VkAttachmentDescription> attachments = {colorAttachment, depthAttachment};
+    if (multisampled) {
+        attachments.push_back(colorAttachmentResolve);
+    }
     
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -456,24 +1205,12 @@ void Renderer::createRenderPass(){
     colorAttachmentResolveRef.attachment = 2;
     colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
     
-    std::array<VkSubpassDependency, 1> subpassDependencies;
-    
-    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;                             // outside of render pass
-    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // pipeline stage
-    subpassDependencies[0].srcAccessMask = 0;
-    subpassDependencies[0].dependencyFlags = 0;
-
-    // from undefined to color attachment optimal
-    subpassDependencies[0].dstSubpass = 0;
-    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = 1;
     subpass.pColorAttachments = &colorAttachmentRef;                                // subpass needs to reference attachment
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorAttachmentResolveRef;
+    subpass.pResolveAttachments = multisampled ? &colorAttachmentResolveRef : nullptr;
     
     VkRenderPassCreateInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -481,10 +1218,10 @@ void Renderer::createRenderPass(){
     renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = static_cast<uint32_t>(subpassDependencies.size());
-    renderPassInfo.pDependencies = subpassDependencies.data();
+    renderPassInfo.dependencyCount = 0;                 // the frame graph's barriers order the pass against the rest of the frame
+    renderPassInfo.pDependencies = nullptr;
 
-    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(device, &renderPassInfo, getHostCallbacks(), &renderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
 }
@@ -495,13 +1232,21 @@ void Renderer::createDescriptorSetLayout(){
     uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    
+    VkDescriptorSetLayoutBinding transformLayoutBinding{};
+    transformLayoutBinding.binding = 1;
+    transformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    transformLayoutBinding.descriptorCount = 1;
+    transformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, transformLayoutBinding };
             
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
     
-    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout);
+    VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, getHostCallbacks(), &descriptorSetLayout);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
@@ -518,7 +1263,7 @@ void Renderer::createDescriptorSetLayout(){
     textureLayoutCreateInfo.bindingCount = 1;
     textureLayoutCreateInfo.pBindings = &samplerLayoutBinding;
     
-    result = vkCreateDescriptorSetLayout(device, &textureLayoutCreateInfo, nullptr, &samplerSetLayout);
+    result = vkCreateDescriptorSetLayout(device, &textureLayoutCreateInfo, getHostCallbacks(), &samplerSetLayout);
     if(result != VK_SUCCESS){
         throw std::runtime_error("failed to create a descriptor set layout.");
     }
@@ -531,109 +1276,6 @@ void Renderer::createPushConstantRange(){
 }
 
 void Renderer::createGraphicsPipeline(){
-    auto vertShaderCode = readFile("Shaders/shader1_vert.spv");
-    auto fragShaderCode = readFile("Shaders/shader1_frag.spv");
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-    
-    // optional: shader specialization allows passing in the constant values used in shader code
-    // these constant values are substituted at compiled time to remove unnecessary code such as
-    // conditionals that dependes on the passed-in constant value. This results in shorter compiler
-    // shader code and efficient compiled machine code.
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-    
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-    
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-    
-    // vertex input bindings info and vertex binding attributes
-    auto bindingDescription = Vertex::getBindingDescription();
-    auto attributeDescriptions = Vertex::getAttributeDescriptions();
-    
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-    
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;       // draw triangles with 3 vertices at a time
-    inputAssembly.primitiveRestartEnable = VK_FALSE;                    // for strip topology only
-    
-    VkViewport viewport{};                              // region of the framebuffer output will be rendered to.
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) swapchainExtent.width;
-    viewport.height = (float) swapchainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    
-    VkRect2D scissor{};                                 // region of pixels on framebuffer to be rendered to
-    scissor.offset = {0, 0};
-    scissor.extent = swapchainExtent;
-    
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-    
-    // rasterizer stage does depth testing, scissor tests and face culling
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;                     // discard fragments beyond [near, far] plane
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-    
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_TRUE;                             // one fragment one sample
-    multisampling.minSampleShading = 0.2f;
-    multisampling.rasterizationSamples = msaaSamples;                        // one pixel one sample so which ever fragment is in front has the pixel
-    
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
-    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencil.depthBoundsTestEnable = VK_FALSE;
-    depthStencil.stencilTestEnable = VK_FALSE;
-    
-    // color blending for one (per-attached) framebuffer
-    // alpha blending for the framebuffer
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_TRUE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-    
-    // global blending settings for all framebuffers
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-        
     std::array<VkDescriptorSetLayout, 2> descriptorSetLayouts = { descriptorSetLayout, samplerSetLayout };
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
@@ -643,42 +1285,83 @@ void Renderer::createGraphicsPipeline(){
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, getHostCallbacks(), &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
     
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = &depthStencil;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
-    pipelineInfo.subpass = 0;
-    
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+    createPipelineVariants();
+}
+
+void Renderer::createPipelineVariants(){
+    for (uint32_t variant = 0; variant < PIPELINE_VARIANT_COUNT; variant++) {
+        shadingPipelineDescs[variant * 2] = getShadingPipelineDesc(variant, false);
+        shadingPipelineDescs[variant * 2 + 1] = getShadingPipelineDesc(variant, true);
     }
+    depthPrepassPipelineDesc = getDepthPrepassPipelineDesc();
+    
+    // the fallback every draw can use, built before the first frame
+    graphicsPipeline = pipelineLibrary.build(shadingPipelineDescs[PIPELINE_VARIANT_TEXTURED * 2]);
     
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    // everything else compiles in the background, toggling the pre-pass or a new material finds it ready
+    for (const PipelineDesc &desc : shadingPipelineDescs) {
+        pipelineLibrary.request(desc);
+    }
+    pipelineLibrary.request(depthPrepassPipelineDesc);
+}
+
+PipelineDesc Renderer::getShadingPipelineDesc(uint32_t variant, bool depthEqual){
+    PipelineDesc desc;
+    desc.vertexShader = "Shaders/shader1_vert.spv";
+    desc.fragmentShader = "Shaders/shader1_frag.spv";
+    desc.specialization = { (variant & PIPELINE_VARIANT_TEXTURED) ? 1u : 0u };
+    desc.samples = msaaSamples;
+    desc.renderPass = renderPass;
+    desc.colorFormat = swapchainImageFormat;
+    desc.depthFormat = depthFormat;
+    desc.layout = pipelineLayout;
+    desc.dynamicDepthState = extendedDynamicState;
+    
+    // after a depth pre-pass the depth is final, so only the nearest surface of each sample is shaded.
+    // With extended dynamic state that is set while recording and the same pipeline serves both.
+    if (depthEqual && !extendedDynamicState) {
+        desc.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        desc.depthWrite = false;
+    }
+    return desc;
+}
+
+PipelineDesc Renderer::getDepthPrepassPipelineDesc(){
+    // position stream, no fragment shader and no color writes
+    PipelineDesc desc;
+    desc.vertexShader = "Shaders/depth_vert.spv";
+    desc.positionsOnly = true;
+    desc.colorWrite = false;
+    desc.blend = false;
+    desc.sampleShading = false;
+    desc.samples = msaaSamples;
+    desc.renderPass = renderPass;
+    desc.colorFormat = swapchainImageFormat;
+    desc.depthFormat = depthFormat;
+    desc.layout = pipelineLayout;
+    desc.dynamicDepthState = extendedDynamicState;
+    return desc;
 }
 
 void Renderer::createFramebuffers() {
     swapchainFramebuffers.resize(swapchainImages.size());
     
     for(size_t i = 0; i < swapchainImageViews.size(); ++i){
+        // with dynamic resolution every framebuffer renders into the same internal target
+        VkImageView targetView = dynamicResolution ? frameGraph.getImageView(targetResource) : swapchainImageViews[i];
+        
         std::vector<VkImageView> attachments = {
-            colorImageView,
-            depthBufferImageView,
-            swapchainImageViews[i]
+            frameGraph.getImageView(colorResource),
+            frameGraph.getImageView(depthResource),
+            targetView
         };
+        if (msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+            attachments = { targetView, frameGraph.getImageView(depthResource) };
+        }
         
         VkFramebufferCreateInfo framebufferInfo{};
         framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -689,7 +1372,7 @@ void Renderer::createFramebuffers() {
         framebufferInfo.height = swapchainExtent.height;
         framebufferInfo.layers = 1;
         
-        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapchainFramebuffers[i]) != VK_SUCCESS) {
+        if (vkCreateFramebuffer(device, &framebufferInfo, getHostCallbacks(), &swapchainFramebuffers[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create framebuffer!");
         }
     }
@@ -701,18 +1384,11 @@ void Renderer::createCommandPool(){
     graphicsPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
     graphicsPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     
-    if (vkCreateCommandPool(device, &graphicsPoolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(device, &graphicsPoolInfo, getHostCallbacks(), &graphicsCommandPool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool!");
     }
     
-    VkCommandPoolCreateInfo transferPoolInfo{};
-    transferPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    transferPoolInfo.queueFamilyIndex = queueFamilyIndices.transferFamily.value();
-    transferPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-    
-    if (vkCreateCommandPool(device, &transferPoolInfo, nullptr, &transferCommandPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create command pool!");
-    }
+    uploader = Uploader(physicalDevice, device, transferQueue, queueFamilyIndices);
 }
 
 VkFormat Renderer::findDepthFormat(){
@@ -724,46 +1400,152 @@ VkFormat Renderer::findDepthFormat(){
         );
 }
 
-void Renderer::createDepthBuffer(){
+void Renderer::createUniformBuffers(){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    
+    // each frame in flight gets its own slice, offsets must respect the descriptor alignment
+    VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    VkDeviceSize sliceSize = (sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment;
+    VkDeviceSize bufferSize = sliceSize * frames.size();
+    
     QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {} };
 
-    VkFormat depthBufferFormat = findDepthFormat();
+    createBuffer(device,
+                 physicalDevice,
+                 ids,
+                 bufferSize,
+                 VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 uniformBuffer, uniformBufferMemory);
     
-    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, graphicsCommandPool);
-    createImage(device,
-                physicalDevice,
-                ids,
-                swapchainExtent.width, swapchainExtent.height,
-                1, msaaSamples,
-                depthBufferFormat,
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                depthBufferImage, depthBufferImageMemory);
-    depthBufferImageView = createImageView(depthBufferImage, depthBufferFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
-    transitionImageLayout(commandBuffer,
-                          depthBufferImage,
-                          depthBufferFormat,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
-    flushSetupCommands(device, commandBuffer, graphicsCommandPool, graphicsQueue);
+    void* data;
+    vkMapMemory(device, uniformBufferMemory, 0, bufferSize, 0, &data);
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].uniformOffset = sliceSize * i;
+        frames[i].uniformData = reinterpret_cast<UniformBufferObject*>(static_cast<char*>(data) + frames[i].uniformOffset);
+    }
 }
 
-void Renderer::createUniformBuffers(){
-    VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+void Renderer::createTransformBuffers(){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    
+    VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
+    VkDeviceSize sliceSize = (sizeof(glm::mat4) * MAX_SCENE_NODES + alignment - 1) / alignment * alignment;
+    VkDeviceSize bufferSize = sliceSize * frames.size();
+    
+    // read by the culling pass as well, which may run on the compute queue
+    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {}, queueFamilyIndices.computeFamily };
+    
+    createBuffer(device,
+                 physicalDevice,
+                 ids,
+                 bufferSize,
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 transformBuffer, transformBufferMemory);
+    
+    void* data;
+    vkMapMemory(device, transformBufferMemory, 0, bufferSize, 0, &data);
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].transformOffset = sliceSize * i;
+        frames[i].transformData = reinterpret_cast<glm::mat4*>(static_cast<char*>(data) + frames[i].transformOffset);
+        
+        // a fresh slice has to receive every existing node, not only the dirty ones
+        sceneGraph.collectAll(frames[i].pendingTransforms);
+    }
+}
 
-    uniformBuffers.resize(swapchainImages.size());
-    uniformBuffersMemory.resize(swapchainImages.size());
+void Renderer::createCullBuffers(){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    VkDeviceSize alignment = properties.limits.minStorageBufferOffsetAlignment;
     
-    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {} };
+    QueueFamilyIndices ids = { queueFamilyIndices.graphicsFamily, {}, {}, queueFamilyIndices.computeFamily };
+    
+    VkDeviceSize inputSliceSize = (sizeof(DrawCullInput) * MAX_DRAWS + alignment - 1) / alignment * alignment;
+    createBuffer(device,
+                 physicalDevice,
+                 ids,
+                 inputSliceSize * frames.size(),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 drawInputBuffer, drawInputBufferMemory);
+    
+    // only ever written by the culling pass
+    VkDeviceSize commandSliceSize = (sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAWS + alignment - 1) / alignment * alignment;
+    createBuffer(device,
+                 physicalDevice,
+                 ids,
+                 commandSliceSize * frames.size(),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                 drawCommandBuffer, drawCommandBufferMemory);
+    
+    void* data;
+    vkMapMemory(device, drawInputBufferMemory, 0, inputSliceSize * frames.size(), 0, &data);
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].drawInputOffset = inputSliceSize * i;
+        frames[i].drawInputData = reinterpret_cast<DrawCullInput*>(static_cast<char*>(data) + frames[i].drawInputOffset);
+        frames[i].drawCommandOffset = commandSliceSize * i;
+        frames[i].drawListRevision = 0;
+    }
+}
 
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
-        createBuffer(device,
-                     physicalDevice,
-                     ids,
-                     bufferSize,
-                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     uniformBuffers[i], uniformBuffersMemory[i]);
+void Renderer::createCullPipeline(){
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;        // transforms, draw inputs, draw commands
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, getHostCallbacks(), &cullSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor set layout.");
+    }
+    
+    VkPushConstantRange cullPushConstantRange{};
+    cullPushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullPushConstantRange.offset = 0;
+    cullPushConstantRange.size = sizeof(CullPushConstants);
+    
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &cullPushConstantRange;
+    
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, getHostCallbacks(), &cullPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout.");
+    }
+    
+    auto compShaderCode = readFile("Shaders/cull_comp.spv");
+    VkShaderModule compShaderModule = createShaderModule(compShaderCode);
+    
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = compShaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = cullPipelineLayout;
+    
+    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, getHostCallbacks(), &cullPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline.");
     }
+    
+    vkDestroyShaderModule(device, compShaderModule, getHostCallbacks());
 }
 
 void Renderer::createSamplerDescriptorPool(){
@@ -773,54 +1555,64 @@ void Renderer::createSamplerDescriptorPool(){
 
     VkDescriptorPoolCreateInfo samplerPoolCreateInfo = {};
     samplerPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    samplerPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;   // sets of unloaded textures go back to the pool
     samplerPoolCreateInfo.maxSets = MAX_OBJECTS;
     samplerPoolCreateInfo.poolSizeCount = 1;
     samplerPoolCreateInfo.pPoolSizes = &samplerPoolSize;
 
-    VkResult result = vkCreateDescriptorPool(device, &samplerPoolCreateInfo, nullptr, &samplerDescriptorPool);
+    VkResult result = vkCreateDescriptorPool(device, &samplerPoolCreateInfo, getHostCallbacks(), &samplerDescriptorPool);
     if(result != VK_SUCCESS){
        throw std::runtime_error("failed to create a descriptor pool.");
     }
 }
 
 void Renderer::createDescriptorPool(){
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSize.descriptorCount = static_cast<uint32_t>(swapchainImages.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = static_cast<uint32_t>(frames.size());
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = static_cast<uint32_t>(frames.size()) * 4;     // transforms + the cull set's three
     
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = static_cast<uint32_t>(swapchainImages.size());
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = static_cast<uint32_t>(frames.size()) * 2;
 
-    VkResult result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+    VkResult result = vkCreateDescriptorPool(device, &poolInfo, getHostCallbacks(), &descriptorPool);
     if (result != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor pool.");
     }
 }
 
 void Renderer::createDescriptorSets(){
-    std::vector<VkDescriptorSetLayout> layouts(swapchainImages.size(), descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(frames.size(), descriptorSetLayout);
+    std::vector<VkDescriptorSet> descriptorSets(frames.size());
     
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(swapchainImages.size());
+    allocInfo.descriptorSetCount = static_cast<uint32_t>(frames.size());
     allocInfo.pSetLayouts = layouts.data();
     
-    descriptorSets.resize(swapchainImages.size());
     if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets.");
     }
     
-    for (size_t i = 0; i < swapchainImages.size(); i++) {
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].descriptorSet = descriptorSets[i];
+        
         VkDescriptorBufferInfo bufferInfo{};
-        bufferInfo.buffer = uniformBuffers[i];
-        bufferInfo.offset = 0;
+        bufferInfo.buffer = uniformBuffer;
+        bufferInfo.offset = frames[i].uniformOffset;
         bufferInfo.range = sizeof(UniformBufferObject);
         
-        std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
+        VkDescriptorBufferInfo transformBufferInfo{};
+        transformBufferInfo.buffer = transformBuffer;
+        transformBufferInfo.offset = frames[i].transformOffset;
+        transformBufferInfo.range = sizeof(glm::mat4) * MAX_SCENE_NODES;
+        
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
         descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrites[0].dstSet = descriptorSets[i];
         descriptorWrites[0].dstBinding = 0;
@@ -829,144 +1621,434 @@ void Renderer::createDescriptorSets(){
         descriptorWrites[0].descriptorCount = 1;
         descriptorWrites[0].pBufferInfo = &bufferInfo;
         
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = descriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pBufferInfo = &transformBufferInfo;
+        
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+    
+    std::vector<VkDescriptorSetLayout> cullLayouts(frames.size(), cullSetLayout);
+    std::vector<VkDescriptorSet> cullDescriptorSets(frames.size());
+    allocInfo.pSetLayouts = cullLayouts.data();
+    
+    if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cull descriptor sets.");
+    }
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].cullDescriptorSet = cullDescriptorSets[i];
+        
+        std::array<VkDescriptorBufferInfo, 3> bufferInfos{};
+        bufferInfos[0].buffer = transformBuffer;
+        bufferInfos[0].offset = frames[i].transformOffset;
+        bufferInfos[0].range = sizeof(glm::mat4) * MAX_SCENE_NODES;
+        bufferInfos[1].buffer = drawInputBuffer;
+        bufferInfos[1].offset = frames[i].drawInputOffset;
+        bufferInfos[1].range = sizeof(DrawCullInput) * MAX_DRAWS;
+        bufferInfos[2].buffer = drawCommandBuffer;
+        bufferInfos[2].offset = frames[i].drawCommandOffset;
+        bufferInfos[2].range = sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAWS;
+        
+        std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
+        for (uint32_t j = 0; j < descriptorWrites.size(); j++) {
+            descriptorWrites[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[j].dstSet = cullDescriptorSets[i];
+            descriptorWrites[j].dstBinding = j;
+            descriptorWrites[j].dstArrayElement = 0;
+            descriptorWrites[j].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[j].descriptorCount = 1;
+            descriptorWrites[j].pBufferInfo = &bufferInfos[j];
+        }
+        
         vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     }
 }
 
 void Renderer::createCommandBuffers(){
-    commandBuffers.resize(swapchainFramebuffers.size());
+    // a transient pool per frame in flight, recycled as a whole once the frame's timeline value is reached
+    for (auto &frame : frames) {
+        frame.commandAllocator = LinearCommandAllocator(device, queueFamilyIndices.graphicsFamily.value());
+    }
+    
+    computeScheduler = ComputeScheduler(device, computeQueue, queueFamilyIndices, static_cast<uint32_t>(frames.size()), settings.asyncCompute);
+    
+    createCachedCommandBuffers();
+}
+
+void Renderer::createCachedCommandBuffers(){
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;    // re-recorded one by one when stale
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
     
-    VkCommandBufferAllocateInfo cbAllocInfo = {};
-    cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cbAllocInfo.commandPool = graphicsCommandPool;
-    cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;    // send to queue directly
-    cbAllocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    for (auto &frame : frames) {
+        if (frame.cachedCommandPool == VK_NULL_HANDLE &&
+            vkCreateCommandPool(device, &poolInfo, getHostCallbacks(), &frame.cachedCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create a cached command pool.");
+        }
         
-    VkResult result = vkAllocateCommandBuffers(device, &cbAllocInfo, commandBuffers.data());
-    if(result != VK_SUCCESS){
-        throw std::runtime_error("failed to allocate command buffers.");
+        // buffers are never freed here, one may still be pending from an earlier frame. A frame only
+        // re-records its own buffers after waiting for its timeline value, so they are only ever grown.
+        size_t existing = frame.cachedCommandBuffers.size();
+        if (swapchainImages.size() > existing) {
+            frame.cachedCommandBuffers.resize(swapchainImages.size());
+            
+            VkCommandBufferAllocateInfo cbAllocInfo = {};
+            cbAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cbAllocInfo.commandPool = frame.cachedCommandPool;
+            cbAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cbAllocInfo.commandBufferCount = static_cast<uint32_t>(swapchainImages.size() - existing);
+            
+            if (vkAllocateCommandBuffers(device, &cbAllocInfo, frame.cachedCommandBuffers.data() + existing) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate cached command buffers.");
+            }
+        }
+        frame.cachedRevisions.assign(frame.cachedCommandBuffers.size(), 0);    // 0 never matches the scene revision
     }
 }
 
-void Renderer::recordCommands(uint32_t currentImage){
+void Renderer::recordCommands(FrameResources &frame, uint32_t currentImage, VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags usage){
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.flags = usage;
     
-    if (vkBeginCommandBuffer(commandBuffers[currentImage], &beginInfo) != VK_SUCCESS) {
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
         throw std::runtime_error("failed to begin recording command buffer!");
     }
     
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapchainFramebuffers[currentImage];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapchainExtent;
+    // GPU time of the frame's graphics work, read back once the frame's timeline value is reached
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, timestampQueryPool, frame.timestampQuery, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, frame.timestampQuery);
+    }
+    
+    // fragment shader invocations of the frame, the depth pre-pass has no fragment shader and adds none
+    if (statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, frame.statisticsQuery, 1);
+        vkCmdBeginQuery(commandBuffer, statisticsQueryPool, frame.statisticsQuery, 0);
+    }
+    
+    // barriers and layout transitions come from the compiled frame graph. The callback captures a single
+    // reference, which std::function stores without allocating.
+    auto recordPass = [&](RenderGraph::Pass pass) {
+        if (pass == mainPass) {
+            recordMainPass(frame, currentImage, commandBuffer);
+        } else if (dynamicResolution && pass == upscalePass) {
+            recordUpscale(currentImage, commandBuffer);
+        }
+    };
+    frameGraph.bindImage(swapchainResource, swapchainImages[currentImage]);
+    frameGraph.execute(commandBuffer, frame.arena, [&recordPass](RenderGraph::Pass pass) { recordPass(pass); });
+    
+    if (statisticsQueryPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, statisticsQueryPool, frame.statisticsQuery);
+    }
+    if (timestampQueryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, frame.timestampQuery + 1);
+    }
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+void Renderer::recordMainPass(FrameResources &frame, uint32_t currentImage, VkCommandBuffer commandBuffer){
+    VkRect2D renderArea{};
+    renderArea.offset = {0, 0};
+    renderArea.extent = getRenderExtent();
     
     std::array<VkClearValue, 2> clearValues{};
     clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
     clearValues[1].depthStencil = {1.0f, 0}; // depth and then stencil values
-
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
     
-    vkCmdBeginRenderPass(commandBuffers[currentImage], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if (dynamicRendering) {
+        beginMainRendering(currentImage, commandBuffer, renderArea, clearValues);
+    } else {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = swapchainFramebuffers[currentImage];
+        renderPassInfo.renderArea = renderArea;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    }
     
-    vkCmdBindPipeline(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    VkViewport viewport{};                              // region of the framebuffer output will be rendered to.
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) renderArea.extent.width;
+    viewport.height = (float) renderArea.extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+    if (extendedDynamicState) {
+        cmdSetCullMode(commandBuffer, VK_CULL_MODE_BACK_BIT);
+        cmdSetDepthTestEnable(commandBuffer, VK_TRUE);
+    }
+    
+    // draw order has to match updateCulling(), the culling pass writes one indirect command per mesh.
+    // Sorted by state, so most binds repeat the previous one and are dropped by the tracker.
+    StateTracker state(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    
+    // variants still compiling draw with the fallback of their pass. Without the pre-pass pipelines the
+    // frame is drawn without a pre-pass.
+    VkPipeline depthPrepassPipeline = VK_NULL_HANDLE;
+    VkPipeline depthEqualPipeline = VK_NULL_HANDLE;
+    if (settings.depthPrepass) {
+        depthPrepassPipeline = pipelineLibrary.request(depthPrepassPipelineDesc);
+        depthEqualPipeline = pipelineLibrary.request(shadingPipelineDescs[PIPELINE_VARIANT_TEXTURED * 2 + 1]);
+    }
+    bool depthPrepass = depthPrepassPipeline != VK_NULL_HANDLE && depthEqualPipeline != VK_NULL_HANDLE;
+    
+    std::array<VkPipeline, PIPELINE_VARIANT_COUNT> shadingPipelines;
+    for (uint32_t variant = 0; variant < PIPELINE_VARIANT_COUNT; variant++) {
+        VkPipeline pipeline = pipelineLibrary.request(shadingPipelineDescs[variant * 2 + (depthPrepass ? 1 : 0)]);
+        shadingPipelines[variant] = pipeline != VK_NULL_HANDLE ? pipeline : (depthPrepass ? depthEqualPipeline : graphicsPipeline);
+    }
+    
+    // depth pre-pass over the same indirect commands, culled meshes stay culled. Both pipelines share the
+    // layout, so set 0 and the push constants carry over into the main loop.
+    if (depthPrepass) {
+        if (extendedDynamicState) {
+            cmdSetDepthWriteEnable(commandBuffer, VK_TRUE);
+            cmdSetDepthCompareOp(commandBuffer, VK_COMPARE_OP_LESS);
+        }
+        VkDeviceSize depthOffset = frame.drawCommandOffset;
+        for(uint32_t index : drawOrder){
+            DrawItem &item = drawList[index];
+            PushConstantModel pcm = { item.nodeId };
+            
+            state.bindPipeline(depthPrepassPipeline);
+            state.bindDescriptorSet(pipelineLayout, 0, frame.descriptorSet);
+            state.pushConstants(pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstantModel), &pcm);
+            state.bindVertexBuffer(item.mesh.getPositionBuffer());
+            state.bindIndexBuffer(item.mesh.getIndexBuffer(), VK_INDEX_TYPE_UINT32);
+            
+            vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, depthOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+            depthOffset += sizeof(VkDrawIndexedIndirectCommand);
+        }
+    }
     
-    for(size_t j = 0; j < modelList.size(); ++j){
-        MeshModel thisModel = modelList[j];
-        glm::mat4 model = thisModel.getModel();
-        PushConstantModel pcm = { model };
+    if (extendedDynamicState) {
+        cmdSetDepthWriteEnable(commandBuffer, depthPrepass ? VK_FALSE : VK_TRUE);
+        cmdSetDepthCompareOp(commandBuffer, depthPrepass ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS);
+    }
+    VkDeviceSize drawOffset = frame.drawCommandOffset;
+    for(uint32_t index : drawOrder){
+        DrawItem &item = drawList[index];
+        PushConstantModel pcm = { item.nodeId };
         
-        vkCmdPushConstants(commandBuffers[currentImage],
-                           pipelineLayout,
-                           VK_SHADER_STAGE_VERTEX_BIT,
-                           0,
-                           sizeof(PushConstantModel),
-                           &pcm);
+        state.bindPipeline(shadingPipelines[item.pipelineId]);
+        state.bindDescriptorSet(pipelineLayout, 0, frame.descriptorSet);
+        state.bindDescriptorSet(pipelineLayout, 1, textures.at(item.texId).descriptorSet);
+        state.pushConstants(pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstantModel), &pcm);
+        state.bindVertexBuffer(item.mesh.getVertexBuffer());
+        state.bindIndexBuffer(item.mesh.getIndexBuffer(), VK_INDEX_TYPE_UINT32);
         
-        for(size_t i = 0; i < thisModel.getMeshCount(); ++i){
-            VkBuffer vertexBuffers[] = {thisModel.getMesh(i)->getVertexBuffer()};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffers[currentImage], 0, 1, vertexBuffers, offsets);
-            
-            vkCmdBindIndexBuffer(commandBuffers[currentImage], thisModel.getMesh(i)->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        // execute pipeline, instance count is 0 when culled
+        vkCmdDrawIndexedIndirect(commandBuffer, drawCommandBuffer, drawOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+        drawOffset += sizeof(VkDrawIndexedIndirectCommand);
+    }
+    frameStats.bindsIssued += state.getIssuedCount();
+    frameStats.bindsElided += state.getElidedCount();
+    
+    if (dynamicRendering) {
+        cmdEndRendering(commandBuffer);
+    } else {
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
 
-            std::array<VkDescriptorSet, 2> descriptorSetGroup = { descriptorSets[currentImage], samplerDescriptorSets[thisModel.getMesh(i)->getTexId()] };
+void Renderer::beginMainRendering(uint32_t currentImage, VkCommandBuffer commandBuffer, VkRect2D renderArea,
+                                  const std::array<VkClearValue, 2> &clearValues){
+    // same attachments as createFramebuffers(), bound by image view. Layouts come from the frame graph.
+    VkImageView targetView = dynamicResolution ? frameGraph.getImageView(targetResource) : swapchainImageViews[currentImage];
+    bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+    
+    VkRenderingAttachmentInfoKHR colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    colorAttachment.imageView = multisampled ? frameGraph.getImageView(colorResource) : targetView;
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearValues[0];
+    if (multisampled) {
+        colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+        colorAttachment.resolveImageView = targetView;
+        colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+    
+    VkRenderingAttachmentInfoKHR depthAttachment{};
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    depthAttachment.imageView = frameGraph.getImageView(depthResource);
+    depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.clearValue = clearValues[1];
+    
+    VkRenderingInfoKHR renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    renderingInfo.renderArea = renderArea;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+    renderingInfo.pDepthAttachment = &depthAttachment;
+    
+    cmdBeginRendering(commandBuffer, &renderingInfo);
+}
 
-            vkCmdBindDescriptorSets(commandBuffers[currentImage], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(descriptorSetGroup.size()), descriptorSetGroup.data(), 0, nullptr);
+void Renderer::recordUpscale(uint32_t currentImage, VkCommandBuffer commandBuffer){
+    VkExtent2D renderExtent = getRenderExtent();
+    
+    VkImageBlit blit{};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.mipLevel = 0;
+    blit.srcSubresource.baseArrayLayer = 0;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[0] = {0, 0, 0};
+    blit.srcOffsets[1] = {static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1};
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[0] = {0, 0, 0};
+    blit.dstOffsets[1] = {static_cast<int32_t>(swapchainExtent.width), static_cast<int32_t>(swapchainExtent.height), 1};
+    
+    // bilinear upscale of the rendered part of the target
+    vkCmdBlitImage(commandBuffer,
+                   frameGraph.getImage(targetResource), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   swapchainImages[currentImage], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &blit,
+                   VK_FILTER_LINEAR);
+}
 
-            // execute pipeline
-            vkCmdDrawIndexed(commandBuffers[currentImage], static_cast<uint32_t>(thisModel.getMesh(i)->getIndexCount()), 1, 0, 0, 0);
-        }
+VkExtent2D Renderer::getRenderExtent(){
+    if (!dynamicResolution) {
+        return swapchainExtent;
     }
     
-    vkCmdEndRenderPass(commandBuffers[currentImage]);
-
-    if (vkEndCommandBuffer(commandBuffers[currentImage]) != VK_SUCCESS) {
-        throw std::runtime_error("failed to record command buffer!");
-    }
+    float scale = resolutionController.getScale();
+    VkExtent2D extent;
+    extent.width = std::max(1u, static_cast<uint32_t>(swapchainExtent.width * scale));
+    extent.height = std::max(1u, static_cast<uint32_t>(swapchainExtent.height * scale));
+    return extent;
 }
 
 void Renderer::createSynchronizations(){
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imagesInFlight.resize(swapchainImages.size(), VK_NULL_HANDLE);
-
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i])) {
+    for (auto &frame : frames) {
+        if (vkCreateSemaphore(device, &semaphoreInfo, getHostCallbacks(), &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+            vkCreateSemaphore(device, &semaphoreInfo, getHostCallbacks(), &frame.renderFinishedSemaphore) != VK_SUCCESS) {
             throw std::runtime_error("failed to create synchronizations object for a frame.");
         }
     }
 }
 
-int Renderer::createTextureImage(std::string fileName){
-    int texWidth, texHeight, texChannels;
-    stbi_uc* pixels = stbi_load(fileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-    VkDeviceSize imageSize = texWidth * texHeight * 4;
+void Renderer::createTimestampQueries(){
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
     
-    if (!pixels) {
-        throw std::runtime_error("failed to load texture image!");
+    uint32_t validBits = queueFamilies[queueFamilyIndices.graphicsFamily.value()].timestampValidBits;
+    if (validBits == 0 || properties.limits.timestampPeriod == 0.0f) {
+        return;                         // no timestamps, the resolution stays at its maximum
     }
+    timestampPeriod = properties.limits.timestampPeriod;
+    timestampMask = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
     
-    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+    // two per frame in flight: start and end of the frame's graphics work
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(frames.size()) * 2;
+    
+    if (vkCreateQueryPool(device, &queryPoolInfo, getHostCallbacks(), &timestampQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a timestamp query pool.");
+    }
+    
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].timestampQuery = static_cast<uint32_t>(i) * 2;
+    }
+}
+
+void Renderer::createStatisticsQueries(){
+    if (!pipelineStatistics) {
+        return;
+    }
+    
+    // one per frame in flight, only the fragment shader invocation counter
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(frames.size());
+    queryPoolInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+    
+    if (vkCreateQueryPool(device, &queryPoolInfo, getHostCallbacks(), &statisticsQueryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create a pipeline statistics query pool.");
+    }
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    for (size_t i = 0; i < frames.size(); i++) {
+        frames[i].statisticsQuery = static_cast<uint32_t>(i);
+    }
+}
 
-    QueueFamilyIndices ids = { {}, {}, queueFamilyIndices.transferFamily };
+void Renderer::readStatistics(FrameResources &frame){
+    if (statisticsQueryPool == VK_NULL_HANDLE || !frame.queriesPending) {
+        return;
+    }
+    
+    uint64_t fragmentInvocations = 0;
+    VkResult result = vkGetQueryPoolResults(device, statisticsQueryPool, frame.statisticsQuery, 1,
+                                            sizeof(fragmentInvocations), &fragmentInvocations, sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (result == VK_SUCCESS) {
+        frameStats.fragmentInvocations += fragmentInvocations;
+    }
+}
 
-    createBuffer(device,
-                 physicalDevice,
-                 ids,
-                 imageSize,
-                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
+void Renderer::readTimestamps(FrameResources &frame){
+    if (timestampQueryPool == VK_NULL_HANDLE || !frame.queriesPending) {
+        return;
+    }
     
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
+    // the frame's timeline value has been reached, so the results are final
+    std::array<uint64_t, 2> timestamps;
+    VkResult result = vkGetQueryPoolResults(device, timestampQueryPool, frame.timestampQuery, 2,
+                                            sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
     
-    stbi_image_free(pixels);
+    uint64_t ticks = ((timestamps[1] & timestampMask) - (timestamps[0] & timestampMask)) & timestampMask;
+    double gpuTime = static_cast<double>(ticks) * timestampPeriod / 1000000.0;
+    frameStats.gpuTime += gpuTime;
+    
+    // a new scale changes the viewport and render area baked into recorded command buffers
+    if (dynamicResolution && resolutionController.update(gpuTime)) {
+        sceneRevision++;
+    }
+}
 
-    QueueFamilyIndices indices = { queueFamilyIndices.graphicsFamily, {}, queueFamilyIndices.transferFamily };
+void Renderer::createTextureImage(const unsigned char *pixels, uint32_t texWidth, uint32_t texHeight, Texture &texture){
+    VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+    
+    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+    // exclusive to graphics, the uploader hands ownership over after the copy
+    QueueFamilyIndices indices = { queueFamilyIndices.graphicsFamily, {}, {} };
     
-    VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
     createImage(device,
                 physicalDevice,
                 indices,
@@ -976,33 +2058,13 @@ int Renderer::createTextureImage(std::string fileName){
                 VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                textureImage, textureImageMemory);
+                texture.image, texture.memory);
 
-    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, transferCommandPool);
-    transitionImageLayout(commandBuffer,
-                          textureImage,
-                          VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-    copyBufferToImage(commandBuffer,
-                      stagingBuffer,
-                      textureImage,
-                      static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-    flushSetupCommands(device, commandBuffer, transferCommandPool, transferQueue);
-    
-    commandBuffer = setUpCommandBuffer(device, graphicsCommandPool);
-    generateMipmaps(physicalDevice, commandBuffer, textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
-    flushSetupCommands(device, commandBuffer, graphicsCommandPool, graphicsQueue);
-    
-    textureImages.push_back(textureImage);
-    textureImagesMemory.push_back(textureImageMemory);
-    
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
-    
-    return static_cast<int>(textureImages.size() - 1);
+    // mip generation is recorded into the next frame's graphics submission
+    uploader.uploadImage(texture.image, VK_FORMAT_R8G8B8A8_SRGB, pixels, imageSize, texWidth, texHeight, mipLevels);
 }
 
-int Renderer::createTextureDescriptor(VkImageView textureImage){
+VkDescriptorSet Renderer::createTextureDescriptor(VkImageView textureImage){
     VkDescriptorSet descriptorSet;
     
     VkDescriptorSetAllocateInfo setAllocInfo = {};
@@ -1033,34 +2095,95 @@ int Renderer::createTextureDescriptor(VkImageView textureImage){
     
     vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
     
-    samplerDescriptorSets.push_back(descriptorSet);
-    
-    return static_cast<int>(samplerDescriptorSets.size() - 1);
+    return descriptorSet;
 }
 
-void Renderer::createColorBuffer(){
-    QueueFamilyIndices indices = { queueFamilyIndices.graphicsFamily, {}, {}};
-    createImage(device, physicalDevice,
-                indices,
-                swapchainExtent.width, swapchainExtent.height,
-                1, msaaSamples,
-                swapchainImageFormat,
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
-    colorImageView = createImageView(colorImage, swapchainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+void Renderer::createFrameGraph(){
+    // rebuilt with the swapchain, the extent and formats are baked into the transient images
+    frameGraph.reset();
+    
+    VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (hasStencilComponent(depthFormat)) {
+        depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    
+    // acquired images are waited on at color attachment output, the old contents are never needed
+    swapchainResource = frameGraph.importImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT,
+                                               VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    
+    // the main pass renders into a full size internal target and only uses the scaled part of it, so the
+    // framebuffers survive scale changes. Needs blits from and to the swapchain format.
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, swapchainImageFormat, &formatProperties);
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    dynamicResolution = settings.targetFrameTime > 0.0 &&
+                        (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures &&
+                        (swapchainUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    
+    targetResource = swapchainResource;
+    if (dynamicResolution) {
+        RenderGraph::ImageInfo targetInfo = {};
+        targetInfo.format = swapchainImageFormat;
+        targetInfo.extent = swapchainExtent;
+        targetInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        targetInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        targetInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        targetResource = frameGraph.createTransientImage("scaled target", targetInfo);
+    }
+    
+    // without multisampling the target is the color attachment
+    colorResource = targetResource;
+    if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+        RenderGraph::ImageInfo colorInfo = {};
+        colorInfo.format = swapchainImageFormat;
+        colorInfo.extent = swapchainExtent;
+        colorInfo.samples = msaaSamples;
+        colorInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        colorInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        colorResource = frameGraph.createTransientImage("msaa color", colorInfo);
+    }
+    
+    RenderGraph::ImageInfo depthInfo = {};
+    depthInfo.format = depthFormat;
+    depthInfo.extent = swapchainExtent;
+    depthInfo.samples = msaaSamples;
+    depthInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthInfo.aspect = depthAspect;
+    depthResource = frameGraph.createTransientImage("depth", depthInfo);
+    
+    // clears color and depth, resolves into the swapchain image
+    mainPass = frameGraph.addPass("main");
+    frameGraph.write(mainPass, colorResource, ResourceUsage::ColorAttachment);
+    frameGraph.write(mainPass, depthResource, ResourceUsage::DepthAttachment);
+    frameGraph.write(mainPass, targetResource, ResourceUsage::ColorAttachment);
+    
+    if (dynamicResolution) {
+        upscalePass = frameGraph.addPass("upscale");
+        frameGraph.read(upscalePass, targetResource, ResourceUsage::TransferSrc);
+        frameGraph.write(upscalePass, swapchainResource, ResourceUsage::TransferDst);
+    }
+    
+    frameGraph.markOutput(swapchainResource, ResourceUsage::Present);
+    
+    frameGraph.compile();
+    // both attachments are cleared on load and never stored, tile-based GPUs can keep them in on-chip memory
+    frameGraph.allocateTransients(physicalDevice, device, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
 }
 
-int Renderer::createTexture(std::string fileName){
-    if(textureImages.size() >= MAX_OBJECTS){
+TextureHandle Renderer::createTexture(const unsigned char *pixels, uint32_t width, uint32_t height){
+    // live textures only, unloaded ones give their slot and descriptor set back
+    if(textures.getSize() >= MAX_OBJECTS){
         throw std::runtime_error("number of textures created exceeds the MAX_OBJECTS");
     }
     
-    int textureImageLoc = createTextureImage(fileName);
-    VkImageView imageView = createImageView(textureImages[textureImageLoc], VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
-    textureImageViews.push_back(imageView);
+    Texture texture;
+    createTextureImage(pixels, width, height, texture);
+    texture.imageView = createImageView(texture.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    texture.descriptorSet = createTextureDescriptor(texture.imageView);
+    sceneRevision++;
     
-    return createTextureDescriptor(imageView);
+    return textures.insert(texture);
 }
 
 void Renderer::createTextureSampler(){
@@ -1085,7 +2208,7 @@ void Renderer::createTextureSampler(){
     samplerInfo.minLod = static_cast<float>(0);
     samplerInfo.maxLod = static_cast<float>(mipLevels - 1);
     
-    if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
+    if (vkCreateSampler(device, &samplerInfo, getHostCallbacks(), &textureSampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler.");
     }
 }
@@ -1096,7 +2219,7 @@ VkShaderModule Renderer::createShaderModule(const std::vector<char>& code){
     createInfo.codeSize = code.size();
     createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());          // no alignment issue since code.data() is 32 bit aligned by vector class.
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(device, &createInfo, getHostCallbacks(), &shaderModule) != VK_SUCCESS) {
         throw std::runtime_error("failed to create shader module!");
     }
     return shaderModule;
@@ -1115,7 +2238,7 @@ void Renderer::selectPhysicalDevice(){
     
     for(const auto & device: devices){
         if(isDeviceSuitable(device)){
-            msaaSamples = getMaxUsableSampleCount(device);
+            msaaSamples = getMaxUsableSampleCount(device, settings.msaaSamples);
             physicalDevice = device;
             break;
         }
@@ -1140,25 +2263,78 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device){
     for(const auto & queueFamily : queueFamilies){
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
         
-        if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT){
+        if(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !currQueueFamilyIndices.graphicsFamily.has_value()){
             currQueueFamilyIndices.graphicsFamily = i;
         }
-        if(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT){
+        // a transfer-only family is usually backed by the DMA engines and runs alongside graphics
+        if(queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT &&
+           !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+           !currQueueFamilyIndices.transferFamily.has_value()){
             currQueueFamilyIndices.transferFamily = i;
         }
-        if(presentSupport){
-            currQueueFamilyIndices.presentFamily = i;
+        // likewise a compute family without graphics usually maps to separate async compute hardware
+        if(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT &&
+           !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+           !currQueueFamilyIndices.computeFamily.has_value()){
+            currQueueFamilyIndices.computeFamily = i;
         }
-
-        if(currQueueFamilyIndices.isComplete()){
-            break;
+        if(presentSupport && !currQueueFamilyIndices.presentFamily.has_value()){
+            currQueueFamilyIndices.presentFamily = i;
         }
         i++;
     }
     
+    // graphics queues always support transfers
+    if(!currQueueFamilyIndices.transferFamily.has_value()){
+        currQueueFamilyIndices.transferFamily = currQueueFamilyIndices.graphicsFamily;
+    }
+    // and compute
+    if(!currQueueFamilyIndices.computeFamily.has_value()){
+        currQueueFamilyIndices.computeFamily = currQueueFamilyIndices.graphicsFamily;
+    }
+    
     return currQueueFamilyIndices;
 }
 
+bool Renderer::isDeviceExtensionAvailable(const char *extension){
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    
+    return std::any_of(availableExtensions.begin(), availableExtensions.end(), [extension](VkExtensionProperties availableExtension){
+        return strcmp(availableExtension.extensionName, extension) == 0;
+    });
+}
+
+bool Renderer::checkDynamicRenderingSupport(){
+    if (!isDeviceExtensionAvailable(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)) {
+        return false;
+    }
+    
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+    dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &dynamicRenderingFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+    return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+bool Renderer::checkExtendedDynamicStateSupport(){
+    if (!isDeviceExtensionAvailable(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME)) {
+        return false;
+    }
+    
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
+    extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &extendedDynamicStateFeatures;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+    return extendedDynamicStateFeatures.extendedDynamicState == VK_TRUE;
+}
+
 bool Renderer::isDeviceSuitable(VkPhysicalDevice device){
     queueFamilyIndices = findQueueFamilies(device);
     
@@ -1167,13 +2343,20 @@ bool Renderer::isDeviceSuitable(VkPhysicalDevice device){
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
     
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures2{};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &timelineFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+    
     bool swapchainAdequate = false;
     if(extensionSupported){
         SwapChainSupportDetails swapchainSupport = querySwapchainSupport(device);
         swapchainAdequate = swapchainSupport.isAdequate();
     }
     
-    return supportedFeatures.samplerAnisotropy && extensionSupported && swapchainAdequate && queueFamilyIndices.isComplete();
+    return supportedFeatures.samplerAnisotropy && timelineFeatures.timelineSemaphore && extensionSupported && swapchainAdequate && queueFamilyIndices.isComplete();
 }
 
 std::vector<const char*> Renderer::getRequiredExtensions(){
@@ -1231,11 +2414,9 @@ VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabiliti
     if(capabilities.currentExtent.width != UINT32_MAX){
         return capabilities.currentExtent;
     } else {
-        int width, height;
-        glfwGetFramebufferSize(wd, &width, &height);
         VkExtent2D requiredExtent = {
-            static_cast<uint32_t>(width),
-            static_cast<uint32_t>(height)
+            static_cast<uint32_t>(framebufferWidth.load()),
+            static_cast<uint32_t>(framebufferHeight.load())
         };
         
         requiredExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, requiredExtent.width));
@@ -1294,7 +2475,7 @@ void Renderer::setUpDebugMessenger(){
     VkDebugUtilsMessengerCreateInfoEXT createInfo;
     populateDebugMessengerCreateInfo(createInfo);
     
-    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+    if (CreateDebugUtilsMessengerEXT(instance, &createInfo, getHostCallbacks(), &debugMessenger) != VK_SUCCESS) {
         throw std::runtime_error("failed to set up debug messenger!");
     }
 }
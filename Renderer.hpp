@@ -14,6 +14,7 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <cstdlib>
 #include <cstdint> // Necessary for UINT32_MAX
@@ -22,31 +23,132 @@
 #include <stdexcept>
 #include <optional>
 #include <array>
+#include <limits>
 #include <unordered_set>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
 
 #include "stb_image.h"
 
 #include "Utilities.h"
+#include "Uploader.hpp"
+#include "AssetStreamer.hpp"
+#include "JobSystem.hpp"
+#include "FrameArena.hpp"
+#include "AllocationCounter.hpp"
+#include "AssetCache.hpp"
+#include "RadixSort.hpp"
+#include "StateTracker.hpp"
+#include "PipelineLibrary.hpp"
+#include "ComputeScheduler.hpp"
+#include "DeletionQueue.hpp"
+#include "RenderGraph.hpp"
+#include "ResolutionController.hpp"
 #include "Mesh.hpp"
 #include "MeshModel.hpp"
+#include "SceneGraph.hpp"
+#include "TripleBuffer.hpp"
 
+// init() runs on the main thread. draw() and everything else not marked otherwise then belong to the render
+// thread, or to the main thread before the render thread starts.
 class Renderer{
 public:
-    void init(GLFWwindow* window);
+    void init(GLFWwindow* window, RendererSettings newSettings = RendererSettings());
     void cleanUp();
     void draw();
-    void setFramebufferResized(bool resized);
     
-    int createMeshModel(std::string modelFile);
-    void updateModel(int modelId);
+    FrameStats getFrameStats();
+    void resetFrameStats();
+    
+    // simulation thread: fill the snapshot and publish it. Each frame applies the latest one and skips any
+    // published in between, neither thread waits for the other.
+    FrameSnapshot& beginSnapshot();
+    void publishSnapshot();
+    
+    // any thread
+    void setFramebufferSize(int width, int height);
+    // takes effect with the next frame
+    void setDepthPrepass(bool enabled);
+    bool isDepthPrepassEnabled();
+    
+    // returns at once, the model draws a placeholder until its files are streamed in and uploaded.
+    // Materials of the OBJ bring their own textures, textureFile is used where they have none.
+    ModelHandle createMeshModel(std::string modelFile, std::string textureFile = "", ModelHandle parentModel = ModelHandle());
+    // releases the model's buffers and textures once frames in flight are done with them, without stalling.
+    // The handle goes stale, children of the model become roots.
+    void unloadMeshModel(ModelHandle modelHandle);
+    bool isModelLoaded(ModelHandle modelHandle);
+    AssetState getModelState(ModelHandle modelHandle);
+    void setModelTransform(ModelHandle modelHandle, glm::vec3 position, glm::quat rotation, glm::vec3 scale);
     
 private:    
-    // window
+    RendererSettings settings;
+    FrameStats frameStats;
+    
+    // window, sizes are set by the main thread's GLFW callback
     GLFWwindow* wd;
-    bool framebufferResized = false;
+    std::atomic<bool> framebufferResized{false};
+    std::atomic<int> framebufferWidth{0};
+    std::atomic<int> framebufferHeight{0};
+    std::atomic<bool> depthPrepassRequest{false};
+    bool resizePending = false;         // swapchain recreated, the next present ends the resize
+    std::chrono::high_resolution_clock::time_point resizeStart;
     
     // model
-    std::vector<MeshModel> modelList;
+    HandlePool<MeshModel, ModelTag> models;
+    SceneGraph sceneGraph = SceneGraph(MAX_SCENE_NODES);
+    
+    // CPU work split across cores: asset decoding, draw keys and culling inputs
+    JobSystem jobSystem;
+    
+    // asset streaming. Models created from the same files while they load join the same request.
+    struct StreamingRequest {
+        std::vector<ModelHandle> models;
+        std::string pathKey;            // model cache path
+        std::string modelFile;
+        std::string textureFile;
+    };
+    AssetStreamer assetStreamer;
+    std::unordered_map<uint64_t, StreamingRequest> streamingRequests;
+    std::unordered_map<std::string, uint64_t> streamingPaths;
+    Mesh placeholderMesh;
+    TextureHandle placeholderTexture;
+    
+    // GPU assets shared between models, keyed by content hash. A model asset's key covers its texture.
+    AssetCache<TextureHandle> textureCache;
+    AssetCache<ModelAsset> modelCache;
+    
+    // rebuilt when sceneRevision changes, culling inputs and recorded draws follow drawOrder. A new order
+    // bumps sceneRevision.
+    struct DrawItem {
+        Mesh mesh;
+        uint32_t nodeId;
+        int texId;
+        uint32_t pipelineId;        // pipeline variant
+        uint32_t meshId;            // one per vertex buffer
+    };
+    std::vector<DrawItem> drawList;
+    uint64_t drawListRevision = 0;
+    std::vector<uint32_t> drawOrder;
+    std::vector<uint64_t> sortKeys;
+    std::vector<uint32_t> sortedOrder;
+    std::vector<uint64_t> sortKeyScratch;
+    std::vector<uint32_t> sortOrderScratch;
+    
+    // simulation state, the render thread applies the latest snapshot at the start of each frame
+    TripleBuffer<FrameSnapshot> snapshots;
+    uint64_t snapshotsPublishedAtReset = 0;
+    
+    // driver host allocation counts at the last stats reset
+    std::array<uint64_t, HostAllocator::SCOPE_COUNT> driverAllocationsAtReset{};
+    
+    // streaming priorities are distances from here
+    glm::vec3 cameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
+    
+    // bumped by anything that changes recorded commands (models, textures, pipeline, swapchain).
+    // Transforms live in a GPU buffer and do not count.
+    uint64_t sceneRevision = 1;
     
     // vulkan instance
     VkInstance instance;
@@ -59,8 +161,12 @@ private:
     VkQueue graphicsQueue;
     VkQueue presentQueue;
     VkQueue transferQueue;
+    VkQueue computeQueue;
     QueueFamilyIndices queueFamilyIndices;
     
+    // frame pacing, setup work and cross-queue dependencies all wait on these
+    QueueTimeline graphicsTimeline;
+    
     // surface
     VkSurfaceKHR surface;
     
@@ -72,87 +178,147 @@ private:
     
     VkFormat swapchainImageFormat;
     VkExtent2D swapchainExtent;
+    VkImageUsageFlags swapchainUsage;
+    
+    // resources that frames in flight may still use
+    DeletionQueue deletionQueue;
+    
+    // render pass, VK_NULL_HANDLE with dynamic rendering, which begins rendering on the image views directly
+    // and builds pipelines against the attachment formats. Swapchain recreation then leaves pipelines alone
+    // and there are no framebuffers.
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    bool dynamicRendering = false;
+    PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+    PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+    VkFormat depthFormat;
     
-    // render pass
-    VkRenderPass renderPass;
+    // extended dynamic state: cull mode and depth test state are recorded, not baked into pipelines
+    bool extendedDynamicState = false;
+    PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+    PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+    PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+    PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
     
     // pipeline
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorSetLayout samplerSetLayout;
     VkPipelineLayout pipelineLayout;
     VkPushConstantRange pushConstantRange;
-    VkPipeline graphicsPipeline;
+    VkPipeline graphicsPipeline;        // fallback while variants compile, owned by the library
+    PipelineLibrary pipelineLibrary;
+    // built with the variants, recording looks pipelines up without building descriptions
+    std::array<PipelineDesc, PIPELINE_VARIANT_COUNT * 2> shadingPipelineDescs;     // variant * 2 + depthEqual
+    PipelineDesc depthPrepassPipelineDesc;
+    
+    // GPU frustum culling
+    VkDescriptorSetLayout cullSetLayout;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
     
     // commands
     VkCommandPool graphicsCommandPool;
-    VkCommandPool transferCommandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
     
-    // synchronizations
+    // transfer queue uploads, the transfer timeline lives here
+    Uploader uploader;
+    
+    // per-frame compute work, async or inline with graphics
+    ComputeScheduler computeScheduler;
+    
+    // frames in flight
     size_t currentFrame = 0;
-    std::vector<VkSemaphore> imageAvailableSemaphores;
-    std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
+    std::vector<FrameResources> frames;
     
     // images and textures
     uint32_t mipLevels;
-    std::vector<VkImage> textureImages;
-    std::vector<VkDeviceMemory> textureImagesMemory;
-    std::vector<VkImageView> textureImageViews;
+    HandlePool<Texture, TextureTag> textures;          // meshes refer to textures by slot index
     VkSampler textureSampler;
     
-    // UBO
-    std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    // UBO, persistently mapped, one slice per frame in flight
+    VkBuffer uniformBuffer;
+    VkDeviceMemory uniformBufferMemory;
+    
+    // world matrices of all scene graph nodes, persistently mapped, one slice per frame in flight
+    VkBuffer transformBuffer;
+    VkDeviceMemory transformBufferMemory;
+    
+    // culling inputs (persistently mapped) and the indirect draw commands it produces, one slice per frame in flight
+    VkBuffer drawInputBuffer;
+    VkDeviceMemory drawInputBufferMemory;
+    VkBuffer drawCommandBuffer;
+    VkDeviceMemory drawCommandBufferMemory;
     
     // descriptors and push constants
     VkDescriptorPool descriptorPool;
     VkDescriptorPool samplerDescriptorPool;
-    std::vector<VkDescriptorSet> descriptorSets;
-    std::vector<VkDescriptorSet> samplerDescriptorSets;
     
     // MSAA
     VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
-    VkImage colorImage;
-    VkDeviceMemory colorImageMemory;
-    VkImageView colorImageView;
     
-    // depth buffer
-    VkImage depthBufferImage;
-    VkDeviceMemory depthBufferImageMemory;
-    VkImageView depthBufferImageView;
+    // frame graph, owns the MSAA color and depth attachments and every layout transition around the main pass.
+    // Note: only one color and one depth buffer are needed, the drawing operations in the pipeline are one frame
+    // at a time so these attachments can be shared amongst multiple inflight frames no problem.
+    RenderGraph frameGraph;
+    RenderGraph::Resource swapchainResource;
+    RenderGraph::Resource colorResource;
+    RenderGraph::Resource depthResource;
+    RenderGraph::Pass mainPass;
+    
+    // dynamic resolution: the main pass renders a scaled region of targetResource, upscalePass blits it to the
+    // swapchain image. Without it targetResource is the swapchain image.
+    bool dynamicResolution = false;
+    ResolutionController resolutionController;
+    RenderGraph::Resource targetResource;
+    RenderGraph::Pass upscalePass;
+    
+    // GPU frame time
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;       // nanoseconds per tick
+    uint64_t timestampMask = 0;
     
-    // Note: only one color and one depth buffer are needed due to the availability of one graphics pipeline
-    // despite the fact that multiple frames are inflight. The drawing operations in the pipeline is one frame at the time so
-    // these buffers can be shared amongst multiple inflight frames no problem.
+    // fragment shader invocations, for comparing the depth pre-pass against plain rendering
+    bool pipelineStatistics = false;
+    VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
     
     // helper functions
     // creators
     void createInstance();
     void createSurface();
     void createLogicalDevice();
-    void createSwapchain();
+    void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
     void createImageViews();
     void createRenderPass();
     void createDescriptorSetLayout();
     void createPushConstantRange();
     void createGraphicsPipeline();
+    // the fallback pipeline, other variants are queued for background compiles
+    void createPipelineVariants();
+    // shader1 with the variant's specialization constants, EQUAL depth test after a pre-pass
+    PipelineDesc getShadingPipelineDesc(uint32_t variant, bool depthEqual);
+    PipelineDesc getDepthPrepassPipelineDesc();
     void createFramebuffers();
     void createCommandPool();
     void createUniformBuffers();
+    void createTransformBuffers();
+    void createCullBuffers();
+    void createCullPipeline();
     void createDescriptorPool();
     void createDescriptorSets();
     void createCommandBuffers();
+    void createCachedCommandBuffers();
     void createSynchronizations();
-    void createDepthBuffer();
     void createTextureSampler();
     void createSamplerDescriptorPool();
-    void createColorBuffer();
+    void createFrameGraph();
+    void createTimestampQueries();
+    void createStatisticsQueries();
     
-    int createTextureDescriptor(VkImageView textureImage);
-    int createTextureImage(std::string fileName);
-    int createTexture(std::string fileName);
+    VkDescriptorSet createTextureDescriptor(VkImageView textureImage);
+    void createTextureImage(const unsigned char *pixels, uint32_t width, uint32_t height, Texture &texture);
+    TextureHandle createTexture(const unsigned char *pixels, uint32_t width, uint32_t height);
+    void unloadTexture(TextureHandle textureHandle, uint64_t retireValue);
+    // drop a cache reference, the GPU objects go once the last one is gone
+    void releaseTexture(uint64_t textureKey, uint64_t retireValue);
+    void releaseModelAsset(uint64_t assetKey, uint64_t retireValue);
     
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
     VkShaderModule createShaderModule(const std::vector<char>& code);
@@ -161,16 +327,56 @@ private:
     void recreateSwapchain();
     void cleanUpSwapchain();
     
+    // simulation snapshot
+    void applySnapshot();
+    
     // uniform buffer
-    void updateUniformBuffers();
+    void updateUniformBuffer(FrameResources &frame);
+    
+    // transforms
+    void updateTransforms(FrameResources &frame);
+    
+    // streaming
+    void createPlaceholderAssets();
+    void processStreamedAssets();
+    void finishStreamingRequest(StreamingRequest &request, AssetStreamer::Result &result);
+    bool acquireStreamedTextures(AssetStreamer::Result &result, std::vector<uint64_t> &textureKeys);
+    void cancelStreaming(ModelHandle modelHandle, uint64_t request);
+    void updateStreamingPriorities(FrameArena &arena);
+    // models that are not Ready draw the placeholder mesh instead of their own
+    size_t getDrawMeshCount(MeshModel &model);
+    Mesh* getDrawMesh(MeshModel &model, size_t index);
+    
+    // draw list of all meshes, sorted every frame by a key of pipeline, texture, mesh and depth so
+    // recorded state changes are few and opaque geometry is drawn front to back
+    void updateDrawList(FrameArena &arena);
+    void sortDrawList();
+    
+    // culling
+    void updateCulling(FrameResources &frame);
+    void recordCulling(FrameResources &frame, VkCommandBuffer commandBuffer);
     
     // record commands
-    void recordCommands(uint32_t currentImage);
+    void recordCommands(FrameResources &frame, uint32_t currentImage, VkCommandBuffer commandBuffer, VkCommandBufferUsageFlags usage);
+    void recordMainPass(FrameResources &frame, uint32_t currentImage, VkCommandBuffer commandBuffer);
+    void beginMainRendering(uint32_t currentImage, VkCommandBuffer commandBuffer, VkRect2D renderArea,
+                            const std::array<VkClearValue, 2> &clearValues);
+    void recordUpscale(uint32_t currentImage, VkCommandBuffer commandBuffer);
+    
+    // dynamic resolution
+    void readTimestamps(FrameResources &frame);
+    VkExtent2D getRenderExtent();
+    
+    // pipeline statistics
+    void readStatistics(FrameResources &frame);
     
     // devices
     void selectPhysicalDevice();
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
     bool isDeviceSuitable(VkPhysicalDevice device);
+    bool isDeviceExtensionAvailable(const char *extension);
+    bool checkDynamicRenderingSupport();
+    bool checkExtendedDynamicStateSupport();
     VkFormat findDepthFormat();
     
     // getters
@@ -0,0 +1,55 @@
+#include "ResolutionController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// frames the measurement needs to reflect a new scale
+static const uint32_t SETTLING_FRAMES = 8;
+// weight of the newest sample in the moving average
+static const double SMOOTHING = 0.2;
+// relative error tolerated around the target before the scale moves
+static const double TOLERANCE = 0.05;
+
+ResolutionController::ResolutionController(){}
+
+ResolutionController::ResolutionController(double newTargetFrameTime, float newMinScale, float newMaxScale, float newStep){
+    targetFrameTime = newTargetFrameTime;
+    minScale = newMinScale;
+    maxScale = newMaxScale;
+    step = newStep;
+    scale = maxScale;
+}
+
+bool ResolutionController::update(double gpuFrameTime){
+    if (targetFrameTime <= 0.0 || gpuFrameTime <= 0.0) {
+        return false;
+    }
+    
+    smoothedFrameTime = smoothedFrameTime == 0.0 ? gpuFrameTime : smoothedFrameTime + (gpuFrameTime - smoothedFrameTime) * SMOOTHING;
+    
+    if (settlingFrames > 0) {
+        settlingFrames--;
+        return false;
+    }
+    
+    double error = smoothedFrameTime / targetFrameTime;
+    if (error > 1.0 - TOLERANCE && error < 1.0 + TOLERANCE) {
+        return false;
+    }
+    
+    float desired = scale * static_cast<float>(std::sqrt(1.0 / error));
+    desired = std::round(desired / step) * step;
+    desired = std::min(std::max(desired, minScale), maxScale);
+    
+    if (std::fabs(desired - scale) < step * 0.5f) {
+        return false;
+    }
+    
+    scale = desired;
+    settlingFrames = SETTLING_FRAMES;
+    return true;
+}
+
+float ResolutionController::getScale(){
+    return scale;
+}
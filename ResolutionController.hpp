@@ -0,0 +1,33 @@
+#ifndef ResolutionController_hpp
+#define ResolutionController_hpp
+
+#pragma once
+
+#include <cstdint>
+
+// Picks the render resolution scale from measured GPU frame times. GPU cost is taken to be proportional to
+// the pixel count, so the scale that would hit the target is scale * sqrt(target / time). The result is
+// quantized to fixed steps and only applied after a few settling frames, each change invalidates the
+// recorded command buffers so it should not flip every frame.
+class ResolutionController{
+public:
+    ResolutionController();
+    ResolutionController(double targetFrameTime, float minScale, float maxScale, float step);
+    
+    // feeds one GPU frame time in milliseconds, returns true when the scale changed
+    bool update(double gpuFrameTime);
+    
+    float getScale();
+    
+private:
+    double targetFrameTime = 0.0;
+    float minScale = 1.0f;
+    float maxScale = 1.0f;
+    float step = 0.05f;
+    
+    float scale = 1.0f;
+    double smoothedFrameTime = 0.0;
+    uint32_t settlingFrames = 0;        // frames to wait before the next change
+};
+
+#endif /* ResolutionController_hpp */
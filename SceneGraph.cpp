@@ -0,0 +1,358 @@
+#include "SceneGraph.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE
+#endif
+
+// result = a * b, column-major like glm
+static inline void multiplyMatrices(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &result){
+#ifdef SCENE_GRAPH_SSE
+    __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for(int c = 0; c < 4; ++c){
+        __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&result[c][0], column);
+    }
+#else
+    result = a * b;
+#endif
+}
+
+static inline uint32_t countTrailingZeros(uint64_t bits){
+    return static_cast<uint32_t>(__builtin_ctzll(bits));
+}
+
+SceneGraph::SceneGraph() : SceneGraph(UINT32_MAX) {}
+
+SceneGraph::SceneGraph(uint32_t newCapacity){
+    capacity = newCapacity;
+    changedFirstWord = 1;
+    changedLastWord = 0;
+}
+
+uint32_t SceneGraph::createNode(uint32_t parent){
+    // reuse the smallest free id that keeps parents ahead of their children
+    auto freeNode = parent == NO_PARENT ? freeNodes.begin() : freeNodes.upper_bound(parent);
+    if(freeNode != freeNodes.end()){
+        uint32_t node = *freeNode;
+        freeNodes.erase(freeNode);
+        
+        parents[node] = parent;
+        firstChildren[node] = NO_PARENT;
+        nextSiblings[node] = NO_PARENT;
+        if(parent != NO_PARENT){
+            nextSiblings[node] = firstChildren[parent];
+            firstChildren[parent] = node;
+        }
+        resetLocalTransform(node);
+        markDirty(node);
+        
+        return node;
+    }
+    
+    uint32_t node = getNodeCount();
+    if(node >= capacity){
+        throw std::runtime_error("scene graph node capacity exceeded.");
+    }
+    if(parent != NO_PARENT && parent >= node){
+        throw std::runtime_error("scene graph parent must be created before its children.");
+    }
+
+    // SoA arrays grow 4 nodes at a time so batched loads never read past the end.
+    if(node % 4 == 0){
+        size_t paddedSize = node + 4;
+        positionX.resize(paddedSize, 0.0f);
+        positionY.resize(paddedSize, 0.0f);
+        positionZ.resize(paddedSize, 0.0f);
+        rotationX.resize(paddedSize, 0.0f);
+        rotationY.resize(paddedSize, 0.0f);
+        rotationZ.resize(paddedSize, 0.0f);
+        rotationW.resize(paddedSize, 1.0f);
+        scaleX.resize(paddedSize, 1.0f);
+        scaleY.resize(paddedSize, 1.0f);
+        scaleZ.resize(paddedSize, 1.0f);
+    }
+    if(node % 64 == 0){
+        dirtyBits.push_back(0);
+        changedBits.push_back(0);
+    }
+
+    parents.push_back(parent);
+    firstChildren.push_back(NO_PARENT);
+    nextSiblings.push_back(NO_PARENT);
+    if(parent != NO_PARENT){
+        nextSiblings[node] = firstChildren[parent];
+        firstChildren[parent] = node;
+    }
+
+    worldMatrices.push_back(glm::mat4(1.0f));
+    markDirty(node);
+
+    return node;
+}
+
+void SceneGraph::destroyNode(uint32_t node){
+    if(parents[node] != NO_PARENT){
+        unlinkChild(parents[node], node);
+    }
+    
+    // orphans keep their ids, with no parent their world matrix becomes their local one
+    uint32_t child = firstChildren[node];
+    while(child != NO_PARENT){
+        uint32_t next = nextSiblings[child];
+        parents[child] = NO_PARENT;
+        nextSiblings[child] = NO_PARENT;
+        markDirty(child);
+        child = next;
+    }
+    
+    parents[node] = NO_PARENT;
+    firstChildren[node] = NO_PARENT;
+    nextSiblings[node] = NO_PARENT;
+    resetLocalTransform(node);
+    freeNodes.insert(node);
+}
+
+void SceneGraph::unlinkChild(uint32_t parent, uint32_t node){
+    if(firstChildren[parent] == node){
+        firstChildren[parent] = nextSiblings[node];
+        return;
+    }
+    for(uint32_t sibling = firstChildren[parent]; sibling != NO_PARENT; sibling = nextSiblings[sibling]){
+        if(nextSiblings[sibling] == node){
+            nextSiblings[sibling] = nextSiblings[node];
+            return;
+        }
+    }
+}
+
+void SceneGraph::resetLocalTransform(uint32_t node){
+    positionX[node] = positionY[node] = positionZ[node] = 0.0f;
+    rotationX[node] = rotationY[node] = rotationZ[node] = 0.0f;
+    rotationW[node] = 1.0f;
+    scaleX[node] = scaleY[node] = scaleZ[node] = 1.0f;
+}
+
+void SceneGraph::setPosition(uint32_t node, const glm::vec3 &position){
+    positionX[node] = position.x;
+    positionY[node] = position.y;
+    positionZ[node] = position.z;
+    markDirty(node);
+}
+
+void SceneGraph::setRotation(uint32_t node, const glm::quat &rotation){
+    rotationX[node] = rotation.x;
+    rotationY[node] = rotation.y;
+    rotationZ[node] = rotation.z;
+    rotationW[node] = rotation.w;
+    markDirty(node);
+}
+
+void SceneGraph::setScale(uint32_t node, const glm::vec3 &scale){
+    scaleX[node] = scale.x;
+    scaleY[node] = scale.y;
+    scaleZ[node] = scale.z;
+    markDirty(node);
+}
+
+uint32_t SceneGraph::getParent(uint32_t node){
+    return parents[node];
+}
+
+uint32_t SceneGraph::getNodeCount(){
+    return static_cast<uint32_t>(parents.size());
+}
+
+uint32_t SceneGraph::getCapacity(){
+    return capacity;
+}
+
+const glm::mat4* SceneGraph::getWorldMatrices(){
+    return worldMatrices.data();
+}
+
+void SceneGraph::markDirty(uint32_t node){
+    uint64_t bit = uint64_t(1) << (node % 64);
+    if(!(dirtyBits[node / 64] & bit)){
+        dirtyBits[node / 64] |= bit;
+        dirtyNodes.push_back(node);
+    }
+}
+
+bool SceneGraph::update(){
+    // forget what the previous update changed
+    for(uint32_t word = changedFirstWord; word <= changedLastWord; ++word){
+        changedBits[word] = 0;
+    }
+    changedFirstWord = 1;
+    changedLastWord = 0;
+
+    if(dirtyNodes.empty()){
+        return false;
+    }
+
+    // flag the subtrees of every touched node, cost is proportional to the number of dirty nodes.
+    uint32_t minNode = UINT32_MAX;
+    uint32_t maxNode = 0;
+    for(uint32_t node : dirtyNodes){
+        minNode = std::min(minNode, node);
+        maxNode = std::max(maxNode, node);
+        traversalStack.push_back(node);
+        while(!traversalStack.empty()){
+            uint32_t current = traversalStack.back();
+            traversalStack.pop_back();
+            for(uint32_t child = firstChildren[current]; child != NO_PARENT; child = nextSiblings[child]){
+                dirtyBits[child / 64] |= uint64_t(1) << (child % 64);
+                maxNode = std::max(maxNode, child);
+                traversalStack.push_back(child);
+            }
+        }
+    }
+    dirtyNodes.clear();
+
+    // one linear pass over the dirty bitset in id order, 4 nodes per batch
+    uint32_t firstWord = minNode / 64;
+    uint32_t lastWord = maxNode / 64;
+    glm::mat4 localMatrices[4];
+    for(uint32_t word = firstWord; word <= lastWord; ++word){
+        uint64_t bits = dirtyBits[word];
+        while(bits){
+            uint32_t batchShift = countTrailingZeros(bits) & ~3u;
+            uint32_t batch = word * 64 + batchShift;
+            uint32_t laneMask = static_cast<uint32_t>(bits >> batchShift) & 0xF;
+
+            computeLocalMatrices(batch, localMatrices);
+
+            // lanes in order: a parent in the same batch is finished before its child reads it.
+            for(uint32_t lane = 0; lane < 4; ++lane){
+                if(!(laneMask & (1u << lane))){
+                    continue;
+                }
+                uint32_t node = batch + lane;
+                uint32_t parent = parents[node];
+                if(parent == NO_PARENT){
+                    worldMatrices[node] = localMatrices[lane];
+                } else {
+                    multiplyMatrices(worldMatrices[parent], localMatrices[lane], worldMatrices[node]);
+                }
+            }
+            bits &= ~(uint64_t(0xF) << batchShift);
+        }
+    }
+
+    // the dirty set becomes the changed set, the cleared changed set becomes the next dirty set
+    std::swap(dirtyBits, changedBits);
+    changedFirstWord = firstWord;
+    changedLastWord = lastWord;
+    return true;
+}
+
+void SceneGraph::collectAll(std::vector<uint64_t> &pendingBits){
+    uint32_t nodeCount = getNodeCount();
+    pendingBits.assign(changedBits.size(), 0);
+    for(uint32_t node = 0; node < nodeCount; ++node){
+        pendingBits[node / 64] |= uint64_t(1) << (node % 64);
+    }
+}
+
+void SceneGraph::collectChanged(std::vector<uint64_t> &pendingBits){
+    if(pendingBits.size() < changedBits.size()){
+        pendingBits.resize(changedBits.size(), 0);
+    }
+    for(uint32_t word = changedFirstWord; word <= changedLastWord; ++word){
+        pendingBits[word] |= changedBits[word];
+    }
+}
+
+void SceneGraph::writeMatrices(std::vector<uint64_t> &pendingBits, glm::mat4 *dst){
+    for(size_t word = 0; word < pendingBits.size(); ++word){
+        uint64_t bits = pendingBits[word];
+        while(bits){
+            uint32_t node = static_cast<uint32_t>(word * 64) + countTrailingZeros(bits);
+            memcpy(&dst[node], &worldMatrices[node], sizeof(glm::mat4));
+            bits &= bits - 1;
+        }
+        pendingBits[word] = 0;
+    }
+}
+
+// TRS -> matrix for nodes [first, first + 4), one node per SIMD lane.
+void SceneGraph::computeLocalMatrices(uint32_t first, glm::mat4 *localMatrices){
+#ifdef SCENE_GRAPH_SSE
+    __m128 x = _mm_loadu_ps(&rotationX[first]);
+    __m128 y = _mm_loadu_ps(&rotationY[first]);
+    __m128 z = _mm_loadu_ps(&rotationZ[first]);
+    __m128 w = _mm_loadu_ps(&rotationW[first]);
+    __m128 sx = _mm_loadu_ps(&scaleX[first]);
+    __m128 sy = _mm_loadu_ps(&scaleY[first]);
+    __m128 sz = _mm_loadu_ps(&scaleZ[first]);
+
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 two = _mm_set1_ps(2.0f);
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+    __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+    __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+    // rotation columns scaled by the per-axis scale, rows 0..2
+    __m128 c0r0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+    __m128 c0r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+    __m128 c0r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+    __m128 c0r3 = zero;
+
+    __m128 c1r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+    __m128 c1r1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+    __m128 c1r2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+    __m128 c1r3 = zero;
+
+    __m128 c2r0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+    __m128 c2r1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+    __m128 c2r2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+    __m128 c2r3 = zero;
+
+    __m128 c3r0 = _mm_loadu_ps(&positionX[first]);
+    __m128 c3r1 = _mm_loadu_ps(&positionY[first]);
+    __m128 c3r2 = _mm_loadu_ps(&positionZ[first]);
+    __m128 c3r3 = one;
+
+    // after the transpose each register holds one column of one node's matrix
+    _MM_TRANSPOSE4_PS(c0r0, c0r1, c0r2, c0r3);
+    _MM_TRANSPOSE4_PS(c1r0, c1r1, c1r2, c1r3);
+    _MM_TRANSPOSE4_PS(c2r0, c2r1, c2r2, c2r3);
+    _MM_TRANSPOSE4_PS(c3r0, c3r1, c3r2, c3r3);
+
+    __m128 lanes[4][4] = {
+        { c0r0, c1r0, c2r0, c3r0 },
+        { c0r1, c1r1, c2r1, c3r1 },
+        { c0r2, c1r2, c2r2, c3r2 },
+        { c0r3, c1r3, c2r3, c3r3 }
+    };
+    for(int lane = 0; lane < 4; ++lane){
+        for(int c = 0; c < 4; ++c){
+            _mm_storeu_ps(&localMatrices[lane][c][0], lanes[lane][c]);
+        }
+    }
+#else
+    for(uint32_t lane = 0; lane < 4; ++lane){
+        uint32_t i = first + lane;
+        float x = rotationX[i], y = rotationY[i], z = rotationZ[i], w = rotationW[i];
+
+        glm::mat4 &local = localMatrices[lane];
+        local[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * scaleX[i];
+        local[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * scaleY[i];
+        local[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * scaleZ[i];
+        local[3] = glm::vec4(positionX[i], positionY[i], positionZ[i], 1.0f);
+    }
+#endif
+}
@@ -0,0 +1,80 @@
+#ifndef SceneGraph_hpp
+#define SceneGraph_hpp
+
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <set>
+#include <vector>
+
+// Transform hierarchy stored as flat arrays indexed by node id. A node's parent always has a smaller id
+// than the node itself, so walking dirty nodes in id order visits every parent before its children.
+// Local position/rotation/scale live in SoA arrays so the TRS -> matrix conversion runs 4 nodes at a time.
+class SceneGraph{
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    SceneGraph();
+    SceneGraph(uint32_t capacity);
+
+    uint32_t createNode(uint32_t parent = NO_PARENT);
+    // frees the id for reuse, the node's children become roots
+    void destroyNode(uint32_t node);
+
+    void setPosition(uint32_t node, const glm::vec3 &position);
+    void setRotation(uint32_t node, const glm::quat &rotation);
+    void setScale(uint32_t node, const glm::vec3 &scale);
+
+    uint32_t getParent(uint32_t node);
+    uint32_t getNodeCount();
+    uint32_t getCapacity();
+
+    // recomputes world matrices of dirty nodes and their subtrees. Returns false if nothing changed.
+    bool update();
+
+    // flags every existing node, used for destinations that have never been written.
+    void collectAll(std::vector<uint64_t> &pendingBits);
+    // ORs the nodes changed by the last update() into a per-destination bitset (one bit per node).
+    void collectChanged(std::vector<uint64_t> &pendingBits);
+    // copies the world matrix of every node flagged in pendingBits to dst[node] and clears the flags.
+    void writeMatrices(std::vector<uint64_t> &pendingBits, glm::mat4 *dst);
+
+    const glm::mat4* getWorldMatrices();
+
+private:
+    uint32_t capacity;
+
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> firstChildren;
+    std::vector<uint32_t> nextSiblings;
+    // destroyed ids, reused by createNode when larger than the new node's parent
+    std::set<uint32_t> freeNodes;
+
+    // nodes touched through the setters since the last update
+    std::vector<uint32_t> dirtyNodes;
+    std::vector<uint32_t> traversalStack;
+
+    // one bit per node, padded to whole words
+    std::vector<uint64_t> dirtyBits;
+    std::vector<uint64_t> changedBits;
+    uint32_t changedFirstWord = 0;
+    uint32_t changedLastWord = 0;
+
+    // SoA local transforms
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+
+    std::vector<glm::mat4> worldMatrices;
+
+    void markDirty(uint32_t node);
+    void unlinkChild(uint32_t parent, uint32_t node);
+    void resetLocalTransform(uint32_t node);
+    void computeLocalMatrices(uint32_t first, glm::mat4 *localMatrices);
+};
+
+#endif /* SceneGraph_hpp */
@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(set = 0, binding = 1) readonly buffer TransformBuffer {
+    mat4 models[];
+} transforms;
+
+layout(push_constant) uniform PushConstantModel {
+    uint nodeIndex;
+} pcm;
+
+// depth pre-pass: the position stream only, no fragment shader
+layout(location = 0) in vec3 inPosition;
+
+// same expression as shader1.vert so both passes produce identical depth
+invariant gl_Position;
+
+void main(){
+    gl_Position = ubo.proj * ubo.view * transforms.models[pcm.nodeIndex] * vec4(inPosition, 1.0f);
+}
@@ -12,6 +12,13 @@ layout(location = 0) out vec4 outColor;
 
 layout(set = 1, binding = 0) uniform sampler2D texSampler;
 
+// specialization constants, set per pipeline variant. The branch not taken is compiled out.
+layout(constant_id = 0) const bool TEXTURED = true;
+
 void main(){
-    outColor = texture(texSampler, fragTexCoord);
+    if (TEXTURED) {
+        outColor = texture(texSampler, fragTexCoord);
+    } else {
+        outColor = vec4(fragColor, 1.0f);
+    }
 }
@@ -6,8 +6,13 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// world matrices of every scene graph node, written by the CPU only when a node changes
+layout(set = 0, binding = 1) readonly buffer TransformBuffer {
+    mat4 models[];
+} transforms;
+
 layout(push_constant) uniform PushConstantModel {
-    mat4 model;
+    uint nodeIndex;
 } pcm;
 
 layout(location = 0) in vec3 inPosition;
@@ -17,8 +22,11 @@ layout(location = 2) in vec2 inTexCoord;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
+// must match depth.vert bit for bit, the main pass tests EQUAL against the pre-pass depth
+invariant gl_Position;
+
 void main(){
-    gl_Position = ubo.proj * ubo.view * pcm.model * vec4(inPosition, 1.0f);
+    gl_Position = ubo.proj * ubo.view * transforms.models[pcm.nodeIndex] * vec4(inPosition, 1.0f);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
@@ -0,0 +1,91 @@
+#include "StateTracker.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+StateTracker::StateTracker(){}
+
+StateTracker::StateTracker(VkCommandBuffer newCommandBuffer, VkPipelineBindPoint newBindPoint){
+    commandBuffer = newCommandBuffer;
+    bindPoint = newBindPoint;
+    descriptorSets.fill(VK_NULL_HANDLE);
+}
+
+void StateTracker::bindPipeline(VkPipeline newPipeline){
+    if (newPipeline == pipeline) {
+        elided++;
+        return;
+    }
+    vkCmdBindPipeline(commandBuffer, bindPoint, newPipeline);
+    pipeline = newPipeline;
+    issued++;
+}
+
+void StateTracker::bindDescriptorSet(VkPipelineLayout newLayout, uint32_t set, VkDescriptorSet descriptorSet){
+    if (set >= MAX_DESCRIPTOR_SETS) {
+        throw std::runtime_error("descriptor set index exceeds what the state tracker follows.");
+    }
+    useLayout(newLayout);
+    if (descriptorSets[set] == descriptorSet) {
+        elided++;
+        return;
+    }
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, newLayout, set, 1, &descriptorSet, 0, nullptr);
+    descriptorSets[set] = descriptorSet;
+    issued++;
+}
+
+void StateTracker::bindVertexBuffer(VkBuffer buffer){
+    if (buffer == vertexBuffer) {
+        elided++;
+        return;
+    }
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer, &offset);
+    vertexBuffer = buffer;
+    issued++;
+}
+
+void StateTracker::bindIndexBuffer(VkBuffer buffer, VkIndexType newIndexType){
+    if (buffer == indexBuffer && newIndexType == indexType) {
+        elided++;
+        return;
+    }
+    vkCmdBindIndexBuffer(commandBuffer, buffer, 0, newIndexType);
+    indexBuffer = buffer;
+    indexType = newIndexType;
+    issued++;
+}
+
+void StateTracker::pushConstants(VkPipelineLayout newLayout, VkShaderStageFlags stages, uint32_t size, const void *data){
+    if (size > MAX_PUSH_CONSTANT_SIZE) {
+        throw std::runtime_error("push constants exceed what the state tracker follows.");
+    }
+    useLayout(newLayout);
+    if (size == pushSize && stages == pushStages && memcmp(pushData.data(), data, size) == 0) {
+        elided++;
+        return;
+    }
+    vkCmdPushConstants(commandBuffer, newLayout, stages, 0, size, data);
+    memcpy(pushData.data(), data, size);
+    pushSize = size;
+    pushStages = stages;
+    issued++;
+}
+
+uint32_t StateTracker::getIssuedCount(){
+    return issued;
+}
+
+uint32_t StateTracker::getElidedCount(){
+    return elided;
+}
+
+void StateTracker::useLayout(VkPipelineLayout newLayout){
+    // conservative, compatible layouts would keep the lower sets bound
+    if (newLayout != layout) {
+        descriptorSets.fill(VK_NULL_HANDLE);
+        pushSize = 0;
+        layout = newLayout;
+    }
+}
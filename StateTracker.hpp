@@ -0,0 +1,58 @@
+#ifndef StateTracker_hpp
+#define StateTracker_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include <array>
+#include <cstdint>
+
+// Records binds into a command buffer and drops the ones that would not change anything. Only state set
+// through the tracker is known, so it is created once the render pass has begun and used for every bind
+// that follows. Descriptor sets are forgotten when a different pipeline layout is used.
+class StateTracker{
+public:
+    StateTracker();
+    StateTracker(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint);
+    
+    void bindPipeline(VkPipeline pipeline);
+    void bindDescriptorSet(VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptorSet);
+    void bindVertexBuffer(VkBuffer buffer);                 // binding 0, offset 0
+    void bindIndexBuffer(VkBuffer buffer, VkIndexType indexType);
+    // offset 0, at most MAX_PUSH_CONSTANT_SIZE bytes
+    void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t size, const void *data);
+    
+    uint32_t getIssuedCount();
+    uint32_t getElidedCount();
+    
+    static const uint32_t MAX_DESCRIPTOR_SETS = 4;
+    static const uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+    
+private:
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> descriptorSets;
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    
+    std::array<unsigned char, MAX_PUSH_CONSTANT_SIZE> pushData;
+    uint32_t pushSize = 0;
+    VkShaderStageFlags pushStages = 0;
+    
+    uint32_t issued = 0;
+    uint32_t elided = 0;
+    
+    void useLayout(VkPipelineLayout newLayout);
+};
+
+#endif /* StateTracker_hpp */
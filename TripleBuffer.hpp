@@ -0,0 +1,55 @@
+#ifndef TripleBuffer_hpp
+#define TripleBuffer_hpp
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of whole values from one writer thread to one reader thread, each running at its own
+// rate. The writer fills its buffer and publishes it, the reader takes the latest published one. Three
+// buffers mean neither side ever waits: a value published before the reader took the previous one is
+// replaced, not queued. Buffers are reused, so a value that keeps its allocations does not allocate.
+template<typename T>
+class TripleBuffer{
+public:
+    // writer: the buffer to fill, its previous contents are an older value
+    T& getWriteBuffer(){
+        return buffers[writeIndex];
+    }
+    // writer: hands the filled buffer over and takes back the one the reader is not using
+    void publish(){
+        uint32_t previous = middle.exchange(writeIndex | NEW_VALUE, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+        publishedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // reader: the latest published value, nullptr when nothing was published since the last call.
+    // The value stays valid until the next call.
+    const T* acquire(){
+        if ((middle.load(std::memory_order_relaxed) & NEW_VALUE) == 0) {
+            return nullptr;
+        }
+        uint32_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return &buffers[readIndex];
+    }
+
+    // any thread
+    uint64_t getPublishedCount(){
+        return publishedCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    static const uint32_t INDEX_MASK = 3;
+    static const uint32_t NEW_VALUE = 4;        // set in middle when it holds a value the reader has not taken
+
+    std::array<T, 3> buffers;
+    std::atomic<uint32_t> middle{1};
+    uint32_t writeIndex = 0;                    // writer only
+    uint32_t readIndex = 2;                     // reader only
+    std::atomic<uint64_t> publishedCount{0};
+};
+
+#endif /* TripleBuffer_hpp */
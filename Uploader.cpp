@@ -0,0 +1,196 @@
+#include "Uploader.hpp"
+
+Uploader::Uploader(){}
+
+Uploader::Uploader(VkPhysicalDevice newPhysicalDevice, VkDevice newDevice, VkQueue transferQueue, const QueueFamilyIndices &indices){
+    physicalDevice = newPhysicalDevice;
+    device = newDevice;
+    transferFamily = indices.transferFamily.value();
+    graphicsFamily = indices.graphicsFamily.value();
+    
+    timeline.queue = transferQueue;
+    timeline.semaphore = createTimelineSemaphore(device);
+    
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = transferFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    
+    if (vkCreateCommandPool(device, &poolInfo, getHostCallbacks(), &commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create transfer command pool.");
+    }
+}
+
+void Uploader::uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size){
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(data, size, stagingBuffer, stagingBufferMemory);
+    
+    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, commandPool);
+    copyBuffer(commandBuffer, stagingBuffer, dst, size);
+    
+    if (isDedicated()) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;                          // ignored on release
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.buffer = dst;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             1, &barrier,
+                             0, nullptr);
+        
+        // the acquire has to match the release exactly, apart from the access masks
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        bufferAcquires.push_back(barrier);
+    }
+    
+    flush(commandBuffer, stagingBuffer, stagingBufferMemory);
+}
+
+void Uploader::uploadImage(VkImage image, VkFormat format, const void *pixels, VkDeviceSize size,
+                           uint32_t width, uint32_t height, uint32_t mipLevels){
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    createStagingBuffer(pixels, size, stagingBuffer, stagingBufferMemory);
+    
+    VkCommandBuffer commandBuffer = setUpCommandBuffer(device, commandPool);
+    transitionImageLayout(commandBuffer,
+                          image,
+                          format,
+                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+    copyBufferToImage(commandBuffer, stagingBuffer, image, width, height);
+    
+    if (isDedicated()) {
+        // layout stays TRANSFER_DST_OPTIMAL, generateMipmaps expects every level there
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.srcQueueFamilyIndex = transferFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             0, nullptr,
+                             1, &barrier);
+        
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageAcquires.push_back(barrier);
+    }
+    
+    pendingMipmaps.push_back({ image, format, static_cast<int32_t>(width), static_cast<int32_t>(height), mipLevels });
+    
+    flush(commandBuffer, stagingBuffer, stagingBufferMemory);
+}
+
+bool Uploader::hasPendingAcquires(){
+    return !bufferAcquires.empty() || !imageAcquires.empty() || !pendingMipmaps.empty();
+}
+
+void Uploader::recordAcquires(VkCommandBuffer graphicsCommandBuffer){
+    if (!bufferAcquires.empty() || !imageAcquires.empty()) {
+        // chained to the submission's timeline wait through its stages
+        vkCmdPipelineBarrier(graphicsCommandBuffer,
+                             GRAPHICS_WAIT_STAGES, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(bufferAcquires.size()), bufferAcquires.data(),
+                             static_cast<uint32_t>(imageAcquires.size()), imageAcquires.data());
+    }
+    
+    for (auto &mipmaps : pendingMipmaps) {
+        generateMipmaps(physicalDevice, graphicsCommandBuffer, mipmaps.image, mipmaps.format, mipmaps.width, mipmaps.height, mipmaps.mipLevels);
+    }
+    
+    bufferAcquires.clear();
+    imageAcquires.clear();
+    pendingMipmaps.clear();
+}
+
+uint64_t Uploader::takeGraphicsWait(){
+    if (pendingValue == graphicsWaitedValue) {
+        return 0;
+    }
+    graphicsWaitedValue = pendingValue;
+    return pendingValue;
+}
+
+void Uploader::collect(){
+    if (inFlight.empty()) {
+        return;
+    }
+    
+    uint64_t completedValue = 0;
+    vkGetSemaphoreCounterValue(device, timeline.semaphore, &completedValue);
+    
+    size_t finished = 0;
+    while (finished < inFlight.size() && inFlight[finished].value <= completedValue) {
+        InFlightUpload &upload = inFlight[finished++];
+        vkFreeCommandBuffers(device, commandPool, 1, &upload.commandBuffer);
+        vkDestroyBuffer(device, upload.stagingBuffer, getHostCallbacks());
+        vkFreeMemory(device, upload.stagingBufferMemory, getHostCallbacks());
+    }
+    inFlight.erase(inFlight.begin(), inFlight.begin() + finished);
+}
+
+size_t Uploader::getInFlightCount(){
+    return inFlight.size();
+}
+
+QueueTimeline& Uploader::getTimeline(){
+    return timeline;
+}
+
+bool Uploader::isDedicated(){
+    return transferFamily != graphicsFamily;
+}
+
+void Uploader::destroy(){
+    for (auto &upload : inFlight) {
+        vkDestroyBuffer(device, upload.stagingBuffer, getHostCallbacks());
+        vkFreeMemory(device, upload.stagingBufferMemory, getHostCallbacks());
+    }
+    inFlight.clear();
+    
+    vkDestroyCommandPool(device, commandPool, getHostCallbacks());
+    vkDestroySemaphore(device, timeline.semaphore, getHostCallbacks());
+}
+
+void Uploader::createStagingBuffer(const void *data, VkDeviceSize size, VkBuffer &stagingBuffer, VkDeviceMemory &stagingBufferMemory){
+    QueueFamilyIndices ids = { {}, {}, transferFamily };
+    createBuffer(device,
+                 physicalDevice,
+                 ids,
+                 size,
+                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 stagingBuffer, stagingBufferMemory);
+    
+    void* mapped;
+    vkMapMemory(device, stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data, static_cast<size_t>(size));
+    vkUnmapMemory(device, stagingBufferMemory);
+}
+
+void Uploader::flush(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory){
+    // the graphics side waits for pendingValue on the GPU, the CPU only checks it in collect()
+    pendingValue = submitSetupCommands(commandBuffer, timeline);
+    inFlight.push_back({ pendingValue, commandBuffer, stagingBuffer, stagingBufferMemory });
+}
@@ -0,0 +1,93 @@
+#ifndef Uploader_hpp
+#define Uploader_hpp
+
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdocumentation"
+#include <GLFW/glfw3.h>
+#pragma clang diagnostic pop
+
+#include "Utilities.h"
+
+// Streams data into device local resources through the transfer queue. Destination resources are
+// EXCLUSIVE to the graphics family: the transfer queue releases them after the copy and the graphics
+// queue acquires them in recordAcquires(), together with any mip generation (blits need a graphics queue).
+// Without a transfer-only family the transfer queue is the graphics queue and no ownership changes hands, the
+// timeline wait is then the only thing ordering a copy before its readers. Nothing blocks: staging buffers
+// stay alive until collect() sees their transfer timeline value reached.
+class Uploader{
+public:
+    Uploader();
+    Uploader(VkPhysicalDevice physicalDevice, VkDevice device, VkQueue transferQueue, const QueueFamilyIndices &indices);
+    
+    // copies data into dst, the staging buffer is released by a later collect()
+    void uploadBuffer(VkBuffer dst, const void *data, VkDeviceSize size);
+    // fills mip 0 of an image in UNDEFINED layout, the remaining levels are generated on acquire
+    void uploadImage(VkImage image, VkFormat format, const void *pixels, VkDeviceSize size,
+                     uint32_t width, uint32_t height, uint32_t mipLevels);
+    
+    // stages a graphics submission waits at for uploads: vertex fetch and culling read uploaded buffers,
+    // acquires and mip generation are transfers
+    static constexpr VkPipelineStageFlags GRAPHICS_WAIT_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    
+    bool hasPendingAcquires();
+    // records the graphics side of every pending upload, the submission waits through takeGraphicsWait()
+    void recordAcquires(VkCommandBuffer graphicsCommandBuffer);
+    // transfer timeline value the next graphics submission has to wait for at GRAPHICS_WAIT_STAGES, 0 when
+    // an earlier submission already waited for every upload. Independent of acquires: buffer uploads on a
+    // shared family have none.
+    uint64_t takeGraphicsWait();
+    
+    // frees staging buffers and command buffers of finished transfers
+    void collect();
+    size_t getInFlightCount();
+    
+    QueueTimeline& getTimeline();
+    bool isDedicated();
+    
+    // the device has to be idle
+    void destroy();
+    
+private:
+    struct PendingMipmaps {
+        VkImage image;
+        VkFormat format;
+        int32_t width;
+        int32_t height;
+        uint32_t mipLevels;
+    };
+    
+    // submitted transfer, its resources are freed once the timeline reaches value
+    struct InFlightUpload {
+        uint64_t value;
+        VkCommandBuffer commandBuffer;
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+    };
+    
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    
+    uint32_t transferFamily;
+    uint32_t graphicsFamily;
+    
+    QueueTimeline timeline;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    
+    // acquire halves of ownership transfers, waiting for the next graphics submission
+    std::vector<VkBufferMemoryBarrier> bufferAcquires;
+    std::vector<VkImageMemoryBarrier> imageAcquires;
+    std::vector<PendingMipmaps> pendingMipmaps;
+    uint64_t pendingValue = 0;
+    uint64_t graphicsWaitedValue = 0;               // last value a graphics submission waited for
+    
+    std::vector<InFlightUpload> inFlight;          // in submission order
+    
+    void createStagingBuffer(const void *data, VkDeviceSize size, VkBuffer &stagingBuffer, VkDeviceMemory &stagingBufferMemory);
+    void flush(VkCommandBuffer commandBuffer, VkBuffer stagingBuffer, VkDeviceMemory stagingBufferMemory);
+};
+
+#endif /* Uploader_hpp */
@@ -14,11 +14,30 @@
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
-const int MAX_OBJECTS = 20;
-const int MAX_FRAMES_IN_FLIGHT = 2;
+#include "LinearCommandAllocator.hpp"
+#include "FrameArena.hpp"
+#include "HostAllocator.hpp"
+#include "HandlePool.hpp"
+
+const int MAX_OBJECTS = 128;                        // live textures, sizes the sampler descriptor pool
+const uint32_t MAX_FRAMES_IN_FLIGHT = 3;
+const uint32_t MAX_SCENE_NODES = 131072;
+const uint32_t MAX_DRAWS = 16384;                   // meshes the culling pass can handle per frame
+const uint32_t DRAW_JOB_GRAIN = 2048;               // draws per job when per-draw CPU work is split across cores
+const size_t FRAME_ARENA_SIZE = 64 * 1024;          // initial per-frame scratch memory, grows to the largest frame
+
+const float Z_NEAR = 0.1f;
+const float Z_FAR = 10.0f;
+
+const double SIMULATION_STEP = 1.0 / 120.0;         // seconds per simulation tick, independent of the frame rate
+
+// graphics pipeline variants, bits of DrawItem::pipelineId mapped to shader1.frag specialization constants
+const uint32_t PIPELINE_VARIANT_TEXTURED = 1;
+const uint32_t PIPELINE_VARIANT_COUNT = 2;
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
@@ -28,6 +47,8 @@ const std::string BASIC_TEXTURE_PATH = "Textures/texture.jpg";
 const std::string MODEL_PATH = "Models/viking_room.obj";
 const std::string TEXTURE_PATH = "Textures/viking_room.png";
 
+const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
 const std::vector<const char*> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
@@ -43,7 +64,7 @@ const std::vector<const char*> validationLayers = {
 #endif
 
 struct PushConstantModel{
-    alignas(16) glm::mat4 model;    // alignment of offset at 16 bytes (offset % 16 == 0), required by the shader to read
+    uint32_t nodeIndex;             // index of the model's world matrix in the transform storage buffer
 };
 
 struct UniformBufferObject {
@@ -51,10 +72,172 @@ struct UniformBufferObject {
     alignas(16) glm::mat4 proj;     // alignment of offset at 16 bytes
 };
 
+// startup configuration of the renderer
+struct RendererSettings {
+    uint32_t framesInFlight = 2;        // CPU/GPU pipelining depth: 1 favours latency, 3 favours throughput
+    bool cacheCommandBuffers = true;    // resubmit recorded command buffers while the scene revision is unchanged
+    bool asyncCompute = true;           // run compute work on a separate queue when the device has one
+    uint32_t msaaSamples = 4;           // MSAA quality cap, the device maximum is used when it is lower
+    double targetFrameTime = 0.0;       // GPU milliseconds per frame the render resolution is scaled to, 0 keeps it native
+    float minResolutionScale = 0.5f;    // lower bound of the per-axis render scale
+    uint32_t streamingWorkers = 0;      // asset decode threads, 0 picks from the core count
+    uint32_t streamingUploadsPerFrame = 2;  // streamed models uploaded per frame, bounds the hitch of a burst
+    bool depthPrepass = false;          // lay down depth first, then shade with an EQUAL test. Switchable at runtime.
+    uint32_t pipelineWorkers = 1;       // threads compiling pipeline variants
+    bool dynamicRendering = true;       // VK_KHR_dynamic_rendering when the device has it, render passes otherwise
+    bool extendedDynamicState = true;   // VK_EXT_extended_dynamic_state when the device has it
+    uint32_t jobWorkers = 0;            // job system threads, 0 uses every hardware thread besides the render thread
+    bool hostAllocator = true;          // driver host memory from HostAllocator's pools, the driver's own allocator otherwise
+};
+
+// accumulated since the last reset, times in milliseconds
+struct FrameStats {
+    uint64_t frameCount = 0;
+    uint64_t recordedFrames = 0;        // frames whose command buffer had to be recorded
+    double cpuTime = 0.0;               // time spent inside draw()
+    double frameWaitTime = 0.0;         // part of cpuTime blocked on the graphics timeline
+    double commandPoolResetTime = 0.0;  // part of cpuTime spent in vkResetCommandPool
+    VkDeviceSize attachmentMemorySize = 0;      // memory reserved for the transient attachments
+    VkDeviceSize attachmentMemoryCommitted = 0; // part of it actually backed, less when lazily allocated
+    double gpuTime = 0.0;               // graphics queue time measured with timestamps
+    float resolutionScale = 1.0f;       // current per-axis render scale
+    uint32_t textureCount = 0;          // live textures, shared ones count once
+    uint32_t modelAssetCount = 0;       // distinct model files loaded
+    double sortTime = 0.0;              // building and radix sorting the draw keys
+    uint64_t bindsIssued = 0;           // binds in recorded command buffers
+    uint64_t bindsElided = 0;           // redundant binds the state tracker dropped
+    uint64_t fragmentInvocations = 0;   // main pass fragment shader invocations, when pipeline statistics are supported
+    uint32_t pipelineCount = 0;         // pipeline permutations built so far
+    uint32_t resizeCount = 0;
+    double resizeLatency = 0.0;         // swapchain recreation to the first present after it
+    uint64_t snapshotsPublished = 0;    // by the simulation
+    uint64_t snapshotsApplied = 0;      // by the render thread, the rest were superseded before a frame took them
+    double snapshotTime = 0.0;          // taking the latest snapshot and applying it to the scene
+    uint64_t heapAllocations = 0;       // operator new calls on the render thread inside draw(), 0 in the steady state
+    size_t frameArenaPeak = 0;          // most frame arena bytes a frame used
+    // driver host memory by VkSystemAllocationScope, from every thread. Empty without the host allocator.
+    std::array<uint64_t, HostAllocator::SCOPE_COUNT> driverAllocations{};   // allocate and reallocate calls
+    std::array<uint64_t, HostAllocator::SCOPE_COUNT> driverLiveBytes{};
+    uint64_t driverPooledBytes = 0;     // chunks the size-class pools hold
+};
+
+// per-mesh input of the culling pass, std430 layout of DrawInputBuffer in cull.comp
+struct DrawCullInput {
+    glm::vec4 boundingSphere;           // local space center and radius
+    uint32_t nodeIndex;
+    uint32_t indexCount;
+    uint32_t padding[2];
+};
+
+struct CullPushConstants {
+    glm::vec4 frustumPlanes[6];         // world space, normals pointing inwards
+    uint32_t drawCount;
+};
+
+// wait semaphores and command buffers gathered for one queue submission, in the frame's arena
+struct SubmitBatch {
+    explicit SubmitBatch(FrameArena &arena) :
+        waitSemaphores(ArenaAllocator<VkSemaphore>(arena)),
+        waitStages(ArenaAllocator<VkPipelineStageFlags>(arena)),
+        waitValues(ArenaAllocator<uint64_t>(arena)),
+        commandBuffers(ArenaAllocator<VkCommandBuffer>(arena)) {}
+    
+    ArenaVector<VkSemaphore> waitSemaphores;
+    ArenaVector<VkPipelineStageFlags> waitStages;
+    ArenaVector<uint64_t> waitValues;               // ignored for binary semaphores
+    ArenaVector<VkCommandBuffer> commandBuffers;
+};
+
+// a timeline semaphore per queue. Every submission to the queue signals the next value, so a single
+// number tells whether any given piece of work (a frame, an upload) has finished.
+struct QueueTimeline {
+    VkQueue queue = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    uint64_t lastSubmitted = 0;
+};
+
+// everything a frame in flight owns. Nothing here is touched by the CPU until the graphics timeline
+// reaches the frame's timelineValue.
+struct FrameResources {
+    LinearCommandAllocator commandAllocator;    // transient pool, reset wholesale at frame start
+    VkCommandBuffer commandBuffer;              // buffer submitted this frame
+    FrameArena arena = FrameArena(FRAME_ARENA_SIZE);    // CPU temporaries of the frame, reset at frame start
+    
+    // command buffers kept across frames, one per swapchain image, valid while their revision matches the scene's
+    VkCommandPool cachedCommandPool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> cachedCommandBuffers;
+    std::vector<uint64_t> cachedRevisions;
+    
+    VkDeviceSize uniformOffset;         // slice of the shared uniform buffer
+    UniformBufferObject* uniformData;
+    
+    VkDeviceSize transformOffset;       // slice of the shared transform buffer
+    glm::mat4* transformData;
+    std::vector<uint64_t> pendingTransforms;    // scene graph nodes this slice has not received yet
+    
+    VkDescriptorSet descriptorSet;
+    
+    // GPU culling: inputs are rewritten when the scene revision changes, the indirect draw
+    // commands are written by the compute pass every frame
+    VkDeviceSize drawInputOffset;
+    DrawCullInput* drawInputData;
+    VkDeviceSize drawCommandOffset;
+    uint64_t drawListRevision = 0;
+    CullPushConstants cullConstants;
+    VkDescriptorSet cullDescriptorSet;
+    
+    // binary, swapchain acquire and present cannot use timeline semaphores
+    VkSemaphore imageAvailableSemaphore;
+    VkSemaphore renderFinishedSemaphore;
+    uint64_t timelineValue = 0;                 // graphics timeline value signaled by the frame's last submit
+    
+    uint32_t timestampQuery = 0;                // first of the frame's two timestamp queries
+    uint32_t statisticsQuery = 0;               // the frame's pipeline statistics query
+    bool queriesPending = false;                // written by a submit that has not been read back yet
+};
+
+// generational handles handed out by the renderer
+struct ModelTag;
+struct TextureTag;
+typedef Handle<ModelTag> ModelHandle;
+typedef Handle<TextureTag> TextureHandle;
+
+// a model's transform as the simulation sets it
+struct ModelTransform {
+    ModelHandle model;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// what the simulation hands the render thread each tick, immutable once published. Models not listed keep
+// their last transform, the draw list is derived from the scene on the render thread.
+struct FrameSnapshot {
+    uint64_t tick = 0;
+    glm::vec3 cameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
+    std::vector<ModelTransform> transforms;
+};
+
+// streamed assets draw a placeholder until they are Ready, a Failed asset keeps it
+enum class AssetState {
+    Loading,
+    Ready,
+    Failed
+};
+
+// sampled texture with its own descriptor set
+struct Texture {
+    VkImage image = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkImageView imageView = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+};
+
 struct QueueFamilyIndices{
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
     std::optional<uint32_t> transferFamily;
+    std::optional<uint32_t> computeFamily;
     
     bool isComplete(){
         return graphicsFamily.has_value() && presentFamily.has_value() && transferFamily.has_value();
@@ -71,6 +254,9 @@ struct QueueFamilyIndices{
         if(presentFamily.has_value()){
             result.insert(presentFamily.value());
         }
+        if(computeFamily.has_value()){
+            result.insert(computeFamily.value());
+        }
         return result;
     }
 };
@@ -111,6 +297,24 @@ struct Vertex {
         
         return attributeDescriptions;
     }
+    
+    // depth pre-pass input: a tightly packed stream of positions split out of the vertices at upload
+    static VkVertexInputBindingDescription getPositionBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(glm::vec3);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        return bindingDescription;
+    }
+    
+    static VkVertexInputAttributeDescription getPositionAttributeDescription() {
+        VkVertexInputAttributeDescription attributeDescription{};
+        attributeDescription.binding = 0;
+        attributeDescription.location = 0;
+        attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributeDescription.offset = 0;
+        return attributeDescription;
+    }
 };
 
 namespace std {
@@ -216,17 +420,17 @@ static inline void createBuffer(VkDevice device,
     bufferInfo.usage = usage;
     
     std::unordered_set<uint32_t> indicesSet = indices.toSet();
+    std::vector<uint32_t> indicesVec(indicesSet.begin(), indicesSet.end());      // must outlive the create call
     
     if (indicesSet.size() > 1) {
-        std::vector<uint32_t> indicesVec(indicesSet.size());
-        std::copy(indicesSet.begin(), indicesSet.end(), indicesVec.begin());
         bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(indicesVec.size());
         bufferInfo.pQueueFamilyIndices = indicesVec.data();
     } else {
         bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     }
 
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    if (vkCreateBuffer(device, &bufferInfo, getHostCallbacks(), &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer.");
     }
 
@@ -237,7 +441,7 @@ static inline void createBuffer(VkDevice device,
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+    if (vkAllocateMemory(device, &allocInfo, getHostCallbacks(), &bufferMemory) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate vertex buffer memory.");
     }
     
@@ -263,19 +467,77 @@ static inline VkCommandBuffer setUpCommandBuffer(VkDevice device, VkCommandPool
     return commandBuffer;
 }
 
-static inline void flushSetupCommands(VkDevice device,
-                                      VkCommandBuffer commandBuffer,
-                                      VkCommandPool commandPool,
-                                      VkQueue queue) {
+static inline VkSemaphore createTimelineSemaphore(VkDevice device) {
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+    
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+    
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(device, &semaphoreInfo, getHostCallbacks(), &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore.");
+    }
+    return semaphore;
+}
+
+static inline void waitTimeline(VkDevice device, const QueueTimeline &timeline, uint64_t value) {
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline.semaphore;
+    waitInfo.pValues = &value;
+    
+    vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+}
+
+// ends and submits one-time setup commands. The submission signals the next value of the queue's timeline
+// and, if waitTimeline is given, waits on the GPU for waitValue of another queue first. Returns the signaled value.
+static inline uint64_t submitSetupCommands(VkCommandBuffer commandBuffer,
+                                           QueueTimeline &timeline,
+                                           const QueueTimeline *waitTimeline = nullptr,
+                                           uint64_t waitValue = 0) {
     vkEndCommandBuffer(commandBuffer);
+    
+    uint64_t signalValue = ++timeline.lastSubmitted;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = waitTimeline ? 1 : 0;
+    timelineInfo.pWaitSemaphoreValues = &waitValue;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &signalValue;
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    if (waitTimeline) {
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &waitTimeline->semaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &timeline.semaphore;
 
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(queue);
+    if (vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit setup commands.");
+    }
+    
+    return signalValue;
+}
+
+// submits setup commands and blocks until they have executed
+static inline void flushSetupCommands(VkDevice device,
+                                      VkCommandBuffer commandBuffer,
+                                      VkCommandPool commandPool,
+                                      QueueTimeline &timeline) {
+    waitTimeline(device, timeline, submitSetupCommands(commandBuffer, timeline));
 
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
@@ -316,17 +578,17 @@ static inline void createImage(VkDevice device,
     imageInfo.samples = numSamples;
 
     std::unordered_set<uint32_t> indicesSet = indices.toSet();
+    std::vector<uint32_t> indicesVec(indicesSet.begin(), indicesSet.end());      // must outlive the create call
     
     if (indicesSet.size() > 1) {
-        std::vector<uint32_t> indicesVec(indicesSet.size());
-        std::copy(indicesSet.begin(), indicesSet.end(), indicesVec.begin());
         imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(indicesVec.size());
         imageInfo.pQueueFamilyIndices = indicesVec.data();
     } else {
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     }
 
-    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+    if (vkCreateImage(device, &imageInfo, getHostCallbacks(), &image) != VK_SUCCESS) {
         throw std::runtime_error("failed to create image!");
     }
     
@@ -338,7 +600,7 @@ static inline void createImage(VkDevice device,
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+    if (vkAllocateMemory(device, &allocInfo, getHostCallbacks(), &imageMemory) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate image memory!");
     }
 
@@ -527,11 +789,15 @@ static inline void generateMipmaps(VkPhysicalDevice physicalDevice,
 
 }
 
-static inline VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice physicalDevice) {
+// highest sample count supported for both color and depth that does not exceed maxSamples
+static inline VkSampleCountFlagBits getMaxUsableSampleCount(VkPhysicalDevice physicalDevice, uint32_t maxSamples = 64) {
     VkPhysicalDeviceProperties physicalDeviceProperties;
     vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
     VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+    for (uint32_t bit = 64; bit > maxSamples && bit > 1; bit >>= 1) {
+        counts &= ~bit;                 // each sample count flag bit equals its count
+    }
     if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
     if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
     if (counts & VK_SAMPLE_COUNT_16_BIT) { return VK_SAMPLE_COUNT_16_BIT; }
@@ -11,18 +11,377 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <random>
+#include <thread>
+#include <cmath>
 
 #include "Utilities.h"
 #include "Renderer.hpp"
+#include "RadixSort.hpp"
+#include "JobSystem.hpp"
+#include "SceneGraph.hpp"
 
 Renderer renderer;
 
 static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
     auto app = reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window));
-    app->setFramebufferResized(true);
+    app->setFramebufferSize(width, height);
 }
 
-int main() {
+// P toggles the depth pre-pass
+static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    auto app = reinterpret_cast<Renderer*>(glfwGetWindowUserPointer(window));
+    if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        app->setDepthPrepass(!app->isDepthPrepassEnabled());
+        std::cout << "depth pre-pass " << (app->isDepthPrepassEnabled() ? "on" : "off") << std::endl;
+    }
+}
+
+// --frames-in-flight N    explicit pipelining depth
+// --latency               1 frame in flight
+// --throughput            3 frames in flight
+// --no-command-cache      record every frame instead of resubmitting cached command buffers
+// --no-async-compute      run the culling pass on the graphics queue
+// --msaa N                MSAA sample cap, 1 disables multisampling
+// --target-frame-time MS  scale the render resolution to keep GPU frame time near MS
+// --min-scale S           lowest render scale per axis for --target-frame-time, default 0.5
+// --no-dynamic-rendering  use render passes and framebuffers even when VK_KHR_dynamic_rendering is available
+// --no-extended-dynamic-state  bake cull mode and depth state into the pipelines
+// --depth-prepass         start with the depth pre-pass on, P toggles it
+// --single-thread         simulate, poll events and render in one loop instead of a separate render thread
+// --job-workers N         job system threads, 0 uses every hardware thread besides the render thread
+// --no-host-allocator     let the driver allocate its host memory itself, no per-scope counters
+// --benchmark SECONDS     print frame statistics every second and exit after SECONDS
+// --sort-benchmark        time the draw key radix sort on 100k keys and exit
+// --job-benchmark         time job scheduling overhead and parallel-for scaling and exit
+// --scene-benchmark       time the transform update of a 100k node hierarchy with 1% moving and exit
+static RendererSettings parseArguments(int argc, char** argv, double &benchmarkSeconds, bool &sortBenchmark,
+                                       bool &singleThread, bool &jobBenchmark, bool &sceneBenchmark) {
+    RendererSettings settings;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            settings.framesInFlight = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            settings.framesInFlight = 1;
+        } else if (strcmp(argv[i], "--throughput") == 0) {
+            settings.framesInFlight = 3;
+        } else if (strcmp(argv[i], "--no-command-cache") == 0) {
+            settings.cacheCommandBuffers = false;
+        } else if (strcmp(argv[i], "--no-async-compute") == 0) {
+            settings.asyncCompute = false;
+        } else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            settings.msaaSamples = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--target-frame-time") == 0 && i + 1 < argc) {
+            settings.targetFrameTime = std::stod(argv[++i]);
+        } else if (strcmp(argv[i], "--min-scale") == 0 && i + 1 < argc) {
+            settings.minResolutionScale = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-dynamic-rendering") == 0) {
+            settings.dynamicRendering = false;
+        } else if (strcmp(argv[i], "--no-extended-dynamic-state") == 0) {
+            settings.extendedDynamicState = false;
+        } else if (strcmp(argv[i], "--depth-prepass") == 0) {
+            settings.depthPrepass = true;
+        } else if (strcmp(argv[i], "--single-thread") == 0) {
+            singleThread = true;
+        } else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmarkSeconds = std::stod(argv[++i]);
+        } else if (strcmp(argv[i], "--no-host-allocator") == 0) {
+            settings.hostAllocator = false;
+        } else if (strcmp(argv[i], "--job-workers") == 0 && i + 1 < argc) {
+            settings.jobWorkers = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--sort-benchmark") == 0) {
+            sortBenchmark = true;
+        } else if (strcmp(argv[i], "--job-benchmark") == 0) {
+            jobBenchmark = true;
+        } else if (strcmp(argv[i], "--scene-benchmark") == 0) {
+            sceneBenchmark = true;
+        }
+    }
+    return settings;
+}
+
+static void printFrameStats(const FrameStats &stats, double seconds) {
+    if (stats.frameCount == 0) {
+        return;
+    }
+    double frames = static_cast<double>(stats.frameCount);
+    std::cout << "fps: " << frames / seconds
+              << "  cpu: " << stats.cpuTime / frames << " ms"
+              << "  gpu: " << stats.gpuTime / frames << " ms"
+              << "  scale: " << stats.resolutionScale
+              << "  frame wait: " << stats.frameWaitTime / frames << " ms"
+              << "  pool reset: " << stats.commandPoolResetTime / frames << " ms"
+              << "  recorded: " << stats.recordedFrames << "/" << stats.frameCount
+              << "  attachments: " << stats.attachmentMemoryCommitted / (1024 * 1024) << "/"
+              << stats.attachmentMemorySize / (1024 * 1024) << " MB"
+              << "  textures: " << stats.textureCount
+              << "  model assets: " << stats.modelAssetCount
+              << "  sort: " << stats.sortTime / frames << " ms"
+              << "  binds: " << stats.bindsIssued << " issued, " << stats.bindsElided << " elided"
+              << "  fragments: " << stats.fragmentInvocations / stats.frameCount << "/frame"
+              << "  pipelines: " << stats.pipelineCount;
+    if (stats.resizeCount > 0) {
+        std::cout << "  resize to present: " << stats.resizeLatency / stats.resizeCount << " ms";
+    }
+    std::cout << "  snapshots: " << stats.snapshotsApplied << "/" << stats.snapshotsPublished
+              << " applied, " << stats.snapshotTime / frames << " ms"
+              << "  heap allocations: " << static_cast<double>(stats.heapAllocations) / frames << "/frame"
+              << "  frame arena: " << stats.frameArenaPeak / 1024 << " KB";
+    
+    // command, object, cache, device, instance
+    std::cout << "  driver allocs/frame:";
+    for (uint64_t allocations : stats.driverAllocations) {
+        std::cout << " " << static_cast<double>(allocations) / frames;
+    }
+    std::cout << "  driver live KB:";
+    for (uint64_t bytes : stats.driverLiveBytes) {
+        std::cout << " " << bytes / 1024;
+    }
+    std::cout << " (" << stats.driverPooledBytes / 1024 << " pooled)";
+    std::cout << std::endl;
+}
+
+// keys shaped like the renderer's: few pipelines, a few hundred textures and meshes, random depth
+static void runSortBenchmark() {
+    const size_t keyCount = 100000;
+    const int runs = 100;
+    
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> sourceKeys(keyCount);
+    for (auto &key : sourceKeys) {
+        key = ((random() % 4) << 56) | ((random() % 256) << 40) | ((random() % 512) << 24) | (random() & 0xffffff);
+    }
+    
+    std::vector<uint64_t> keys, keyScratch;
+    std::vector<uint32_t> values(keyCount), valueScratch;
+    double total = 0.0;
+    for (int run = 0; run < runs; run++) {
+        keys = sourceKeys;
+        for (uint32_t i = 0; i < keyCount; i++) {
+            values[i] = i;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        radixSort(keys, values, keyScratch, valueScratch);
+        total += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+    
+    bool sorted = std::is_sorted(keys.begin(), keys.end());
+    std::cout << "radix sort of " << keyCount << " keys: " << total / runs << " ms"
+              << (sorted ? "" : "  (NOT SORTED)") << std::endl;
+}
+
+// overhead of an empty job submitted from outside and from inside the workers, then a parallel-for over
+// enough math to scale with every worker count up to the hardware threads
+static void runJobBenchmark() {
+    const uint32_t jobCount = 100000;
+    const uint32_t itemCount = 1u << 22;
+    const int runs = 10;
+    uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    
+    {
+        JobSystem jobs;
+        jobs.start(0);
+        
+        JobSystem::Counter counter;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t i = 0; i < jobCount; i++) {
+            jobs.run([] {}, &counter);
+        }
+        jobs.wait(counter);
+        double external = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        
+        // a single job fans out, its children land in a worker deque and get stolen from there
+        start = std::chrono::high_resolution_clock::now();
+        jobs.run([&jobs] {
+            JobSystem::Counter children;
+            for (uint32_t i = 0; i < jobCount; i++) {
+                jobs.run([] {}, &children);
+            }
+            jobs.wait(children);
+        }, &counter);
+        jobs.wait(counter);
+        double internal = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+        
+        std::cout << "empty job with " << jobs.getWorkerCount() << " workers: " << external / jobCount << " ns submitted outside, "
+                  << internal / jobCount << " ns inside, " << jobs.getStolenCount() << " stolen" << std::endl;
+        jobs.stop();
+    }
+    
+    std::vector<uint32_t> threadCounts;
+    for (uint32_t threads = 1; threads < hardwareThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(hardwareThreads);
+    
+    std::vector<float> values(itemCount);
+    double baseline = 0.0;
+    for (uint32_t threads : threadCounts) {
+        // the calling thread takes part, a job system without workers runs the loop inline
+        JobSystem jobs;
+        if (threads > 1) {
+            jobs.start(threads - 1);
+        }
+        
+        double total = 0.0;
+        for (int run = 0; run < runs; run++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            jobs.parallelFor(itemCount, 16384, [&values](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    float x = static_cast<float>(i);
+                    values[i] = std::sqrt(x) * std::sin(x) + std::cos(x * 0.5f);
+                }
+            });
+            total += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+        double average = total / runs;
+        if (threads == 1) {
+            baseline = average;
+        }
+        std::cout << "parallel for of " << itemCount << " items on " << threads << " threads: " << average << " ms"
+                  << "  speedup: " << baseline / average << std::endl;
+        jobs.stop();
+    }
+}
+
+// 10k objects of 10 nodes each: a root, three children and two grandchildren per child. Every iteration
+// moves 1% of the nodes, picked at random, then does what a frame does with the result: update the world
+// matrices and copy the changed ones to a destination.
+static void runSceneBenchmark() {
+    const uint32_t objectCount = 10000;
+    const uint32_t nodeCount = objectCount * 10;
+    const uint32_t movingCount = nodeCount / 100;
+    const int runs = 1000;
+    
+    SceneGraph sceneGraph(nodeCount);
+    for (uint32_t object = 0; object < objectCount; object++) {
+        uint32_t root = sceneGraph.createNode();
+        sceneGraph.setPosition(root, glm::vec3(static_cast<float>(object), 0.0f, 0.0f));
+        for (uint32_t child = 0; child < 3; child++) {
+            uint32_t node = sceneGraph.createNode(root);
+            sceneGraph.createNode(node);
+            sceneGraph.createNode(node);
+        }
+    }
+    
+    std::vector<glm::mat4> matrices(nodeCount);
+    std::vector<uint64_t> pendingBits;
+    sceneGraph.update();
+    sceneGraph.collectAll(pendingBits);
+    sceneGraph.writeMatrices(pendingBits, matrices.data());
+    
+    std::mt19937 random(1);
+    std::vector<uint32_t> moving(movingCount);
+    double updateTotal = 0.0;
+    double writeTotal = 0.0;
+    uint64_t changedTotal = 0;
+    for (int run = 0; run < runs; run++) {
+        for (auto &node : moving) {
+            node = random() % nodeCount;
+        }
+        
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t node : moving) {
+            sceneGraph.setPosition(node, glm::vec3(static_cast<float>(run), 1.0f, 0.0f));
+        }
+        sceneGraph.update();
+        sceneGraph.collectChanged(pendingBits);
+        auto updated = std::chrono::high_resolution_clock::now();
+        
+        for (uint64_t bits : pendingBits) {
+            changedTotal += static_cast<uint64_t>(__builtin_popcountll(bits));
+        }
+        
+        auto writeStart = std::chrono::high_resolution_clock::now();
+        sceneGraph.writeMatrices(pendingBits, matrices.data());
+        auto end = std::chrono::high_resolution_clock::now();
+        
+        updateTotal += std::chrono::duration<double, std::micro>(updated - start).count();
+        writeTotal += std::chrono::duration<double, std::micro>(end - writeStart).count();
+    }
+    
+    std::cout << "scene graph of " << nodeCount << " nodes, " << movingCount << " moving: update "
+              << updateTotal / runs << " us, write " << writeTotal / runs << " us, "
+              << changedTotal / runs << " nodes changed" << std::endl;
+}
+
+// one simulation tick: the test model spins around z
+static void publishSnapshot(ModelHandle testModel, uint64_t tick) {
+    FrameSnapshot &snapshot = renderer.beginSnapshot();
+    float time = static_cast<float>(tick * SIMULATION_STEP);
+    
+    snapshot.tick = tick;
+    snapshot.cameraPosition = glm::vec3(2.0f, 2.0f, 2.0f);
+    snapshot.transforms.resize(1);
+    snapshot.transforms[0].model = testModel;
+    snapshot.transforms[0].rotation = glm::angleAxis(time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    
+    renderer.publishSnapshot();
+}
+
+// advances the simulation to now in fixed steps and publishes the last one
+static void simulate(ModelHandle testModel, std::chrono::high_resolution_clock::time_point start, uint64_t &tick) {
+    double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    uint64_t target = static_cast<uint64_t>(elapsed / SIMULATION_STEP);
+    if (target > tick) {
+        tick = target;
+        publishSnapshot(testModel, tick);
+    }
+}
+
+// prints once a second, true once the benchmark has run for benchmarkSeconds
+static bool updateBenchmark(double benchmarkSeconds, std::chrono::high_resolution_clock::time_point benchmarkStart,
+                            std::chrono::high_resolution_clock::time_point &reportStart) {
+    if (benchmarkSeconds <= 0.0) {
+        return false;
+    }
+    auto now = std::chrono::high_resolution_clock::now();
+    double reportElapsed = std::chrono::duration<double>(now - reportStart).count();
+    if (reportElapsed >= 1.0) {
+        printFrameStats(renderer.getFrameStats(), reportElapsed);
+        renderer.resetFrameStats();
+        reportStart = now;
+    }
+    return std::chrono::duration<double>(now - benchmarkStart).count() >= benchmarkSeconds;
+}
+
+// renders until the window is closed, a finished benchmark closes it
+static void renderLoop(GLFWwindow* window, double benchmarkSeconds) {
+    auto benchmarkStart = std::chrono::high_resolution_clock::now();
+    auto reportStart = benchmarkStart;
+    
+    while (!glfwWindowShouldClose(window)) {
+        renderer.draw();
+        
+        if (updateBenchmark(benchmarkSeconds, benchmarkStart, reportStart)) {
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+            glfwPostEmptyEvent();
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    double benchmarkSeconds = 0.0;
+    bool sortBenchmark = false;
+    bool singleThread = false;
+    bool jobBenchmark = false;
+    bool sceneBenchmark = false;
+    RendererSettings settings = parseArguments(argc, argv, benchmarkSeconds, sortBenchmark, singleThread, jobBenchmark,
+                                               sceneBenchmark);
+    if (sortBenchmark) {
+        runSortBenchmark();
+        return 0;
+    }
+    if (jobBenchmark) {
+        runJobBenchmark();
+        return 0;
+    }
+    if (sceneBenchmark) {
+        runSceneBenchmark();
+        return 0;
+    }
     
     glfwInit();
 
@@ -30,16 +389,36 @@ int main() {
     
     GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
     
-    renderer.init(window);
-    int testModel = renderer.createMeshModel("testModel");
+    renderer.init(window, settings);
+    ModelHandle testModel = renderer.createMeshModel(MODEL_PATH, TEXTURE_PATH);
     
     glfwSetWindowUserPointer(window, &renderer);
-    while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
-
-        renderer.updateModel(testModel);
-        renderer.draw();
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    
+    auto simulationStart = std::chrono::high_resolution_clock::now();
+    uint64_t tick = 0;
+    publishSnapshot(testModel, tick);
+    
+    if (singleThread) {
+        auto benchmarkStart = std::chrono::high_resolution_clock::now();
+        auto reportStart = benchmarkStart;
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            simulate(testModel, simulationStart, tick);
+            renderer.draw();
+            if (updateBenchmark(benchmarkSeconds, benchmarkStart, reportStart)) {
+                break;
+            }
+        }
+    } else {
+        // GLFW events have to stay on the main thread, it also runs the simulation and never waits on a frame
+        std::thread renderThread(renderLoop, window, benchmarkSeconds);
+        while (!glfwWindowShouldClose(window)) {
+            glfwWaitEventsTimeout(SIMULATION_STEP);
+            simulate(testModel, simulationStart, tick);
+        }
+        renderThread.join();
     }
 
     glfwDestroyWindow(window);